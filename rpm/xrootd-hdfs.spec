@@ -64,6 +64,9 @@ mkdir -p $RPM_BUILD_ROOT%{_libexecdir}/xrootd-hdfs
 install -m 0755 $RPM_BUILD_ROOT%{_bindir}/xrootd_hdfs_envcheck $RPM_BUILD_ROOT%{_libexecdir}/xrootd-hdfs
 rm $RPM_BUILD_ROOT%{_bindir}/xrootd_hdfs_envcheck
 
+# Cache of the Hadoop environment computed by the bootstrap module.
+mkdir -p $RPM_BUILD_ROOT%{_localstatedir}/cache/xrootd-hdfs
+
 # Notice that I don't call ldconfig in post/postun.  This is because libXrdHdfs
 # is really a loadable module, not a shared lib: it's not linked to all the xrootd
 # libs necessary to load it outside xrootd.
@@ -75,7 +78,9 @@ rm $RPM_BUILD_ROOT%{_bindir}/xrootd_hdfs_envcheck
 %{_libdir}/libXrdHdfsReal-*.so
 %{_sysconfdir}/xrootd/xrootd.sample.hdfs.cfg
 %{_libexecdir}/xrootd-hdfs/xrootd_hdfs_envcheck
+%{_bindir}/xrootd_hdfs_replay
 %config(noreplace) %{_sysconfdir}/sysconfig/xrootd-hdfs
+%dir %attr(0755,xrootd,xrootd) %{_localstatedir}/cache/xrootd-hdfs
 %config %{_sysconfdir}/xrootd/config.d/40-xrootd-hdfs.cfg
 
 %files devel
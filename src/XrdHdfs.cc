@@ -13,14 +13,17 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <memory.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <signal.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 
-#include <map>
+#include <atomic>
 
 #include "XrdVersion.hh"
 #include "XrdSec/XrdSecEntity.hh"
@@ -28,14 +31,26 @@
 #include "XrdSys/XrdSysError.hh"
 #include "XrdSys/XrdSysHeaders.hh"
 #include "XrdSys/XrdSysLogger.hh"
-#include "XrdOuc/XrdOucTrace.hh"
 #include "XrdOuc/XrdOucEnv.hh"
 #include "XrdSys/XrdSysPlugin.hh"
 #include "XrdSys/XrdSysPthread.hh"
+#include "XrdSys/XrdSysTimer.hh"
 #include "XrdSec/XrdSecInterface.hh"
 
 #include "XrdHdfs.hh"
+#include "XrdHdfsAccounting.hh"
+#include "XrdHdfsBufPool.hh"
+#include "XrdHdfsCache.hh"
+#include "XrdHdfsCalls.hh"
 #include "XrdHdfsChecksum.hh"
+#include "XrdHdfsFlight.hh"
+#include "XrdHdfsHandleCache.hh"
+#include "XrdHdfsLatency.hh"
+#include "XrdHdfsListing.hh"
+#include "XrdHdfsNamespace.hh"
+#include "XrdHdfsSched.hh"
+#include "XrdHdfsTrace.hh"
+#include "XrdHdfsWorkers.hh"
 
 #define REUSE_CONNECTION 1
 
@@ -46,43 +61,60 @@
 #define MKDIR_PERFORM_CHMOD 0
 #endif
 
-// Static copy of filesystem for when we're used by the cmsd.
-XrdSysMutex XrdHdfsSys::m_fs_mutex;
-hdfsFS XrdHdfsSys::m_cmsd_fs = NULL;
-
 namespace
 {
-   XrdSysMutex g_fs_mutex;
-   std::map<std::string, hdfsFS> g_fs_map;
-
-   hdfsFS hadoop_connect(const char* instance, int port, const char* username)
+   // Namespaces and their shared per-user connections; set up by
+   // XrdHdfsSys::Init.
+   XrdHdfs::NamespaceMap *g_ns_map = NULL;
+
+   // Read buffer counters of all files closed so far, for getStats.
+   std::atomic<unsigned long long> g_readbuf_hits(0);
+   std::atomic<unsigned long long> g_readbuf_partial_hits(0);
+   std::atomic<unsigned long long> g_readbuf_misses(0);
+   std::atomic<unsigned long long> g_readbuf_bypassed(0);
+
+   // Files opened without a read buffer since the pool ran out; logging each
+   // would take the logger's lock on every open while memory is short.
+   std::atomic<unsigned long long> g_readbuf_unbuffered(0);
+
+   // Connect to the namespace serving `path`.
+   hdfsFS hadoop_connect(const char* path, const char* username)
    {
+      XrdHdfs::LatencyTimer timer(XrdHdfs::LatConnect);
 #ifdef REUSE_CONNECTION
-      XrdSysMutexHelper fs_lock(g_fs_mutex);
-      std::map<std::string, hdfsFS>::iterator iter = g_fs_map.find(username);
-      if (iter != g_fs_map.end()) {
-         return iter->second;
-      }
-      hdfsFS fs = hdfsConnectAsUserNewInstance(instance, port, username);
-      if (fs) {
-         g_fs_map.insert(std::pair<std::string, hdfsFS>(username, fs));
+      if (g_ns_map) {
+         return g_ns_map->Acquire(path, username);
       }
-      return fs;
-#else
-      return hdfsConnectAsUserNewInstance(instance, port, username);
 #endif
+      return XrdHdfs::Hdfs::ConnectAsUserNewInstance(
+         g_ns_map ? g_ns_map->NameNode(path).c_str() : "default", 0, username);
    }
 
    void hadoop_disconnect(hdfsFS fs)
    {
-#ifndef REUSE_CONNECTION
-      if (fs != NULL) {
-         hdfsDisconnect(fs);
+#ifdef REUSE_CONNECTION
+      if (g_ns_map) {
+         g_ns_map->Release(fs);
+         return;
       }
 #endif
+      if (fs != NULL) {
+         XrdHdfs::Hdfs::Disconnect(fs);
+      }
    }
 
 
+// Close file handles let go of by the handle cache.
+void CloseHandles(const std::vector<XrdHdfs::HandleCache::Handle> &handles)
+{
+   for (std::vector<XrdHdfs::HandleCache::Handle>::const_iterator iter = handles.begin();
+        iter != handles.end(); ++iter) {
+      XrdHdfs::Hdfs::CloseFile(iter->m_fs, iter->m_fh);
+      hadoop_disconnect(iter->m_fs);
+   }
+}
+
+
 std::string
 ExtractAuthName(const XrdOucEnv *client)
 {
@@ -101,11 +133,160 @@ ExtractAuthName(const XrdOucEnv *client)
     }
 }
 
-hdfsFS hadoop_connect(const XrdOucEnv *client)
+hdfsFS hadoop_connect(const XrdOucEnv *client, const char *path)
 {
     std::string username = ExtractAuthName(client);
     errno = 0;
-    return hadoop_connect("default", 0, username.c_str());
+    return hadoop_connect(path, username.c_str());
+}
+
+// Translate HDFS metadata into the stat structure xrootd expects.
+void FillStat(const hdfsFileInfo &fileInfo, struct stat *buf)
+{
+   memset(buf, 0, sizeof(*buf));
+   buf->st_mode = fileInfo.mPermissions;
+   buf->st_mode |= (fileInfo.mKind == kObjectKindDirectory) ? S_IFDIR : S_IFREG;
+   buf->st_nlink = (fileInfo.mKind == kObjectKindDirectory) ? 0 : 1;
+   buf->st_uid = 1;
+   buf->st_gid = 1;
+   buf->st_size = (fileInfo.mKind == kObjectKindDirectory) ? 4096 : fileInfo.mSize;
+   buf->st_mtime    = fileInfo.mLastMod;
+   buf->st_atime    = fileInfo.mLastMod;
+   buf->st_ctime    = fileInfo.mLastMod;
+   buf->st_dev      = 0;
+   buf->st_ino      = 1; // XRootD assumes offline status when both dev and ino are zero
+}
+
+// The outcome of one hdfsGetPathInfo: zero or an errno value, plus the
+// metadata if the lookup succeeded.
+struct PathInfo
+{
+   int m_errno;
+   struct stat m_stat;
+};
+
+XrdHdfs::SingleFlight<PathInfo> g_pathinfo_flight;
+
+// hdfsGetPathInfo on behalf of `user`, sharing the namenode RPC with any
+// identical lookup already in flight.  Returns 0 and fills `buf`, or returns
+// an errno value (which is also left in errno).
+int CoalescedPathInfo(hdfsFS fs, const char *path, const std::string &user,
+                      struct stat &buf)
+{
+   PathInfo info;
+   g_pathinfo_flight.Do(user + ":" + path, info, [fs, path](PathInfo &result) {
+      errno = 0;
+      hdfsFileInfo *fileInfo = XrdHdfs::Hdfs::GetPathInfo(fs, path);
+      if (fileInfo == NULL) {
+         result.m_errno = errno ? errno : EIO;
+         return;
+      }
+      result.m_errno = 0;
+      FillStat(*fileInfo, &result.m_stat);
+      XrdHdfs::Hdfs::FreeFileInfo(fileInfo, 1);
+   });
+   if (info.m_errno) {
+      errno = info.m_errno;
+      return info.m_errno;
+   }
+   buf = info.m_stat;
+   return 0;
+}
+
+// The name Readdir returns for an entry; mName is a full URI.
+std::string EntryName(const char *mName)
+{
+   std::string full_name = mName;
+   full_name.erase(0, full_name.rfind("/"));
+   return full_name;
+}
+
+// Get the listing of `path` from the shared cache, fetching and publishing
+// it if we are the first to ask.  Returns XrdOssOK or -errno.
+int CachedListing(XrdHdfs::DirCache &cache, hdfsFS fs, const char *path,
+                  const std::string &user, XrdHdfs::DirListingRef &listing)
+{
+   int retc = XrdOssOK;
+   XrdHdfs::DirCache::FetchRef fetch;
+   if (cache.Acquire(path, user, listing, retc, fetch)) return retc;
+
+   int numEntries = 0;
+   errno = 0;
+   hdfsFileInfo *dh = XrdHdfs::Hdfs::ListDirectory(fs, path, &numEntries);
+   if (!dh && errno) {
+      retc = (errno < 0) ? -EIO : -errno;
+      cache.Abandon(fetch, retc);
+      return retc;
+   }
+
+   std::shared_ptr<XrdHdfs::DirListing> result = std::make_shared<XrdHdfs::DirListing>();
+   if (dh) {
+      result->m_entries.resize(numEntries);
+      for (int idx = 0; idx < numEntries; idx++) {
+         XrdHdfs::DirEntry &entry = result->m_entries[idx];
+         entry.m_name = EntryName(dh[idx].mName);
+         FillStat(dh[idx], &entry.m_stat);
+      }
+      XrdHdfs::Hdfs::FreeFileInfo(dh, numEntries);
+   }
+   listing = result;
+   cache.Publish(fetch, listing);
+   return XrdOssOK;
+}
+
+// List `dir` once and record the stat data of every entry, so a burst of
+// stats of its children can be answered from memory.  Returns true if the
+// directory is too big to prefetch; where listings can be paged, we stop
+// as soon as we know.
+bool PrefetchStats(XrdHdfs::StatCache &cache, hdfsFS fs, const std::string &dir,
+                   const std::string &user)
+{
+   std::string prefix = (dir == "/") ? "" : dir;
+   size_t limit = cache.PrefetchLimit();
+   XrdHdfs::StatCache::Stats stats;
+   struct stat buf;
+
+   if (XrdHdfs::DirectoryStream::Available()) {
+      XrdHdfs::DirectoryStream stream;
+      if (stream.Open(fs, dir.c_str())) return false;
+      hdfsFileInfo info;
+      int rc;
+      while ((rc = stream.Next(info)) == 1) {
+         if (stats.size() >= limit) return true;
+         FillStat(info, &buf);
+         stats.push_back(std::make_pair(prefix + EntryName(info.mName), buf));
+      }
+      if (rc < 0) return false;
+   } else {
+      int numEntries = 0;
+      errno = 0;
+      hdfsFileInfo *dh = XrdHdfs::Hdfs::ListDirectory(fs, dir.c_str(), &numEntries);
+      if (!dh) return false;
+      if (static_cast<size_t>(numEntries) > limit) {
+         XrdHdfs::Hdfs::FreeFileInfo(dh, numEntries);
+         return true;
+      }
+      stats.reserve(numEntries);
+      for (int idx = 0; idx < numEntries; idx++) {
+         FillStat(dh[idx], &buf);
+         stats.push_back(std::make_pair(prefix + EntryName(dh[idx].mName), buf));
+      }
+      XrdHdfs::Hdfs::FreeFileInfo(dh, numEntries);
+   }
+   cache.Insert(stats, user);
+   return false;
+}
+
+// The directory containing `path`, or "" for the root.
+std::string ParentPath(const char *path)
+{
+   std::string parent = path;
+   while ((parent.size() > 1) && (parent[parent.size()-1] == '/'))
+      parent.erase(parent.size()-1);
+   std::string::size_type pos = parent.rfind('/');
+   if (pos == std::string::npos || parent.size() <= 1) return "";
+   parent.erase(pos ? pos : 1);
+   return parent;
 }
 
 }
@@ -127,8 +308,6 @@ namespace XrdHdfs
 
 XrdSysError HdfsEroute(0, "hdfs_");
 
-XrdOucTrace OssTrace(&HdfsEroute);
-
 static XrdHdfsSys XrdHdfsSS;
 
 }
@@ -166,7 +345,8 @@ XrdHdfsDirectory::XrdHdfsDirectory(const char *tid) : XrdOssDF(),
    dirPos(0),
    fname(NULL),
    isopen(false),
-   m_stat_buf(NULL)
+   m_stat_buf(NULL),
+   m_stream(NULL)
 {}
 
 int XrdHdfsDirectory::Opendir(const char *dir_path, XrdOucEnv & client)
@@ -179,32 +359,60 @@ int XrdHdfsDirectory::Opendir(const char *dir_path, XrdOucEnv & client)
 */
 {
    static const char *epname = "Opendir";
+   LatencyTimer timer(LatOpendir);
    int retc = XrdOssOK;
 
 // Return an error if we have already opened
    if (isopen) return -EINVAL;
 
+   m_user = ExtractAuthName(&client);
+   OpContext op(OpMeta, m_user);
+
+// Set up values for this directory object
+//
+   if (!(fname = XrdHdfsSS.GetRealPath(dir_path))) {
+       retc = -ENOMEM;
+       goto cleanup;
+   }
+   NoteOp(m_user, fname);
+   dirPos = 0;
+
 // Get the security name, and connect with it
-   hdfsFS fs = hadoop_connect(&client);
+   fs = hadoop_connect(&client, fname);
    if (!fs) {
      retc = XrdHdfsSys::Emsg(epname, error, EIO, "open directory", fname);
      goto cleanup;
    }
 
+// Serve the listing from the shared cache if we can; only one opendir of a
+// given directory fetches it from the namenode at a time.
+//
+   if (XrdHdfsSS.DirListingCache() && !XrdHdfsSS.PagedListing()) {
+      retc = CachedListing(*XrdHdfsSS.DirListingCache(), fs, fname,
+                           m_user, m_listing);
+      if (retc == XrdOssOK) isopen = true;
+      goto cleanup;
+   }
 
-// Set up values for this directory object
+// For huge directories, stream the listing from the namenode a page at a
+// time instead of materializing it all here.
 //
-   if (!(fname = XrdHdfsSS.GetRealPath(dir_path))) {
-       retc = -ENOMEM;
-       goto cleanup;
+   if (XrdHdfsSS.PagedListing() && DirectoryStream::Available()) {
+      m_stream = new DirectoryStream();
+      if ((retc = m_stream->Open(fs, fname))) {
+         delete m_stream;
+         m_stream = NULL;
+         goto cleanup;
+      }
+      isopen = true;
+      goto cleanup;
    }
-   dirPos = 0;
 
 // Open the directory and get it's id
 // HDFS returns NULL but sets errno to 0 if the directory exists and is empty.
 //
    errno = 0;
-   if (!(dh = hdfsListDirectory(fs, fname, &numEntries)) && errno) {
+   if (!(dh = Hdfs::ListDirectory(fs, fname, &numEntries)) && errno) {
       isopen = false;
       retc = (errno < 0) ? -EIO : -errno;
       goto cleanup;
@@ -236,46 +444,68 @@ int XrdHdfsDirectory::Readdir(char * buff, int blen)
 #ifndef NODEBUG
     static const char *epname = "Readdir";
 #endif
+   LatencyTimer timer(LatReaddir);
 
   if (!isopen) return -EBADF;
+  NoteOp(m_user, fname);
 
-// Check if we are at EOF (once there we stay there)
+// Cached listings are already in the form we return.
 //
-   if (dirPos >= numEntries) {
-     *buff = '\0';
-     return 0;
+   if (m_listing) {
+      if (dirPos >= static_cast<int>(m_listing->m_entries.size())) {
+         *buff = '\0';
+         return 0;
+      }
+      const DirEntry &entry = m_listing->m_entries[dirPos++];
+      strlcpy(buff, entry.m_name.c_str(), blen);
+      if (m_stat_buf) {
+         memcpy(m_stat_buf, &entry.m_stat, sizeof(*m_stat_buf));
+      }
+      return XrdOssOK;
    }
 
-  if (!dh)  {
-     XrdHdfsSys::Emsg(epname,error,EBADF,"read directory",fname);
-     return -EBADF;
-  }
+   hdfsFileInfo fileInfo;
+   if (m_stream) {
+// Fetch the next entry; this goes to the namenode once per page.
+//
+      OpContext op(OpMeta, m_user);
+      int rc = m_stream->Next(fileInfo);
+      if (rc < 0) {
+         errno = -rc;
+         return XrdHdfsSys::Emsg(epname,error,-rc,"read directory",fname);
+      }
+      if (rc == 0) {
+         *buff = '\0';
+         return 0;
+      }
+   } else {
+// Check if we are at EOF (once there we stay there)
+//
+      if (dirPos >= numEntries) {
+        *buff = '\0';
+        return 0;
+      }
+
+      if (!dh)  {
+         XrdHdfsSys::Emsg(epname,error,EBADF,"read directory",fname);
+         return -EBADF;
+      }
 
 // Read the next directory entry
 //
-   hdfsFileInfo fileInfo = dh[dirPos];
-   dirPos++;
+      fileInfo = dh[dirPos];
+      dirPos++;
+   }
 
 // Return the actual entry
 //
-   std::string full_name = fileInfo.mName;
-   full_name.erase(0, full_name.rfind("/"));
+   std::string full_name = EntryName(fileInfo.mName);
    strlcpy(buff, full_name.c_str(), blen);
 
 // If Xrootd has provided us with a buffer to place stat information in,
 // copy from hdfsFileInfo to struct stat:
    if (m_stat_buf) {
-      m_stat_buf->st_mode = fileInfo.mPermissions;
-      m_stat_buf->st_mode |= (fileInfo.mKind == kObjectKindDirectory) ? S_IFDIR : S_IFREG;
-      m_stat_buf->st_nlink = (fileInfo.mKind == kObjectKindDirectory) ? 0 : 1;
-      m_stat_buf->st_uid = 1;
-      m_stat_buf->st_gid = 1;
-      m_stat_buf->st_size = (fileInfo.mKind == kObjectKindDirectory) ? 4096 : fileInfo.mSize;
-      m_stat_buf->st_mtime    = fileInfo.mLastMod;
-      m_stat_buf->st_atime    = fileInfo.mLastMod;
-      m_stat_buf->st_ctime    = fileInfo.mLastMod;
-      m_stat_buf->st_dev      = 0;
-      m_stat_buf->st_ino      = 1; // XRootD assumes offline status when both dev and ino are zero
+      FillStat(fileInfo, m_stat_buf);
    }
 
    return XrdOssOK;
@@ -294,7 +524,7 @@ int XrdHdfsDirectory::StatRet(struct stat *buf)
 
    // Check for a null directory handle; this will occur if this object is
    // invalid, or if it is valid but is an empty directory.
-   if ((numEntries > 0) && !dh)  {
+   if (!m_stream && !m_listing && (numEntries > 0) && !dh)  {
       XrdHdfsSys::Emsg(epname,error,EBADF,"read directory",fname);
       return -EBADF;
    }
@@ -304,6 +534,51 @@ int XrdHdfsDirectory::StatRet(struct stat *buf)
   return XrdOssOK;
 }
 
+namespace
+{
+   // Log the first open of each spell without read buffer memory, and how
+   // many there were once memory is available again.
+   void NoteReadBuffer(bool acquired, const char *path)
+   {
+      if (acquired) {
+         unsigned long long unbuffered;
+         if (g_readbuf_unbuffered.load(std::memory_order_relaxed) &&
+             (unbuffered = g_readbuf_unbuffered.exchange(0))) {
+            char count[32];
+            snprintf(count, sizeof(count), "%llu", unbuffered);
+            XrdHdfsSS.Say("Read buffer memory available again; files opened unbuffered: ", count);
+         }
+         return;
+      }
+      if (!g_readbuf_unbuffered++)
+         XrdHdfsSS.Say("Read buffer memory exhausted; reading unbuffered from ", path,
+                       " and further files until memory is available");
+   }
+}
+
+/******************************************************************************/
+/*                          O p e n D e f e r r e d                           */
+/******************************************************************************/
+
+int XrdHdfsFile::OpenDeferred()
+/*
+  Function: Finish an open deferred by lazy open: open the file, unless a
+            cached handle was already found for it, and get a read buffer.
+            Called with readbuf_mutex held.
+
+  Output:   Returns 0 upon success, otherwise an errno value.
+*/
+{
+   if (!fh && (fh = Hdfs::OpenFile(m_fs, fname, O_RDONLY, 0, 0, 0)) == NULL) {
+      return errno ? errno : EIO;
+   }
+   m_open_deferred = false;
+
+   readbuf = XrdHdfsSS.ReadBufferPool()->Acquire(XrdHdfsSS.ReadBufferSize(), readbuf_size);
+   NoteReadBuffer(readbuf != NULL, fname);
+   return 0;
+}
+
 /******************************************************************************/
 /*                                 C l o s e                                  */
 /******************************************************************************/
@@ -317,14 +592,21 @@ int XrdHdfsDirectory::Close(long long *retsz)
   Output:   Returns XrdOssOK upon success and -EBADF upon failure.
 */
 {
+   LatencyTimer timer(LatClosedir);
 
    if (!isopen) return -EBADF;
+   NoteOp(m_user, fname);
 
 // Release the handle
 //
    if (dh != NULL && numEntries >= 0) {
-      hdfsFreeFileInfo(dh, numEntries);
+      Hdfs::FreeFileInfo(dh, numEntries);
    }
+   if (m_stream) {
+      delete m_stream;
+      m_stream = NULL;
+   }
+   m_listing.reset();
 
 // Do some clean-up
 //
@@ -342,7 +624,10 @@ int XrdHdfsDirectory::Close(long long *retsz)
 XrdHdfsDirectory::~XrdHdfsDirectory()
 {
   if (dh != NULL && numEntries >= 0) {
-    hdfsFreeFileInfo(dh, numEntries);
+    Hdfs::FreeFileInfo(dh, numEntries);
+  }
+  if (m_stream) {
+    delete m_stream;
   }
   hadoop_disconnect(fs);
   if (fname) {
@@ -359,6 +644,8 @@ XrdHdfsDirectory::~XrdHdfsDirectory()
 /*                          C o n s t r u c t o r                             */
 /******************************************************************************/
 XrdHdfsFile::XrdHdfsFile(const char *user) : XrdOssDF(), m_fs(NULL), fh(NULL), fname(NULL), m_nextoff(0),
+    m_stat_valid(false), m_writable(false), m_open_deferred(false),
+    m_cksum_calc(user && !strcmp(user, "checksum_calc")),
     readbuf(NULL), readbuf_size(0), readbuf_offset(0), readbuf_len(0),
     readbuf_bypassed(0), readbuf_misses(0), readbuf_hits(0), readbuf_partial_hits(0),
     readbuf_bytes_used(0), readbuf_bytes_loaded(0),
@@ -376,10 +663,31 @@ bool XrdHdfsFile::Connect(const XrdOucEnv &client)
     {
         hadoop_disconnect(m_fs);
     }
-    m_fs = hadoop_connect(&client);
+    m_fs = hadoop_connect(&client, fname);
     return m_fs;
 }
 
+/******************************************************************************/
+/*                        S y n t h e s i z e S t a t                         */
+/******************************************************************************/
+void XrdHdfsFile::SynthesizeStat(off_t size)
+/*
+  Function: Fill m_stat for a regular file of `size` bytes just opened, without
+            asking the namenode.  Only the size is known; the rest is what
+            HDFS gives a new file, and the time of the open.
+*/
+{
+    memset(&m_stat, 0, sizeof(m_stat));
+    m_stat.st_mode  = S_IFREG | 0644;
+    m_stat.st_nlink = 1;
+    m_stat.st_uid   = 1;
+    m_stat.st_gid   = 1;
+    m_stat.st_size  = size;
+    m_stat.st_mtime = m_stat.st_atime = m_stat.st_ctime = time(NULL);
+    m_stat.st_ino   = 1;
+    m_stat_valid = true;
+}
+
 /******************************************************************************/
 /*                                  O p e n                                   */
 /******************************************************************************/
@@ -412,29 +720,33 @@ int XrdHdfsFile::Open(const char               *path,      // In
 #ifndef NODEBUG
    static const char *epname = "open";
 #endif
+   LatencyTimer timer(LatOpen);
    //const int AMode = S_IRWXU|S_IRWXG|S_IROTH|S_IXOTH; // 775
    int open_flag = 0;
 
 // Verify that this object is not already associated with an open file
 //
-   if (fh != NULL)
+   if (fh != NULL || m_open_deferred)
       return -EINVAL;
 
    fname = XrdHdfsSS.GetRealPath(path);
 
-   XrdHdfsSS.Say("File we will access: ", fname);
+   HDFS_TRACE(Open, "open", "File we will access: %s", fname);
+
+// With lazy open, plain reads of data files only check the file exists here;
+// Read opens it and gets the read buffer.  Many opens are only followed by
+// Fstat and Close.
+//
+   bool lazy = XrdHdfsSS.LazyOpen() && !(openMode & (O_WRONLY | O_RDWR | O_TRUNC))
+               && strncmp("/cksums", fname, 7);
 
 // Allocate readbuf
 //
    XrdSysMutexHelper readbuf_lock(readbuf_mutex);
 
-   if( !readbuf ) {
-       readbuf_size = 32768;
-       readbuf = (char *)malloc(readbuf_size);
-       if( !readbuf ) {
-           readbuf_size = 0;
-           XrdHdfsSS.Say("Insufficient memory to allocate read-ahead buffer for ", path);
-       }
+   if( !readbuf && !lazy && !(openMode & (O_WRONLY | O_RDWR)) ) {
+       readbuf = XrdHdfsSS.ReadBufferPool()->Acquire(XrdHdfsSS.ReadBufferSize(), readbuf_size);
+       NoteReadBuffer(readbuf != NULL, path);
    }
 
 // Invalidate contents of readbuf, if any
@@ -467,6 +779,10 @@ int XrdHdfsFile::Open(const char               *path,      // In
        open_flag = O_TRUNC | O_WRONLY;
    }
 
+   m_user = ExtractAuthName(&client);
+   OpContext op(OpMeta, m_user);
+   NoteOp(m_user, fname);
+
 // Setup a new filesystem instance.
    if (!Connect(client))
    {
@@ -477,20 +793,58 @@ int XrdHdfsFile::Open(const char               *path,      // In
 //
 
    int err_code = 0;
+   m_stat_valid = false;
+   m_nextoff = 0;
+
+// A lazy open, or reusing a cached handle, needs the file's metadata before
+// any hdfsOpenFile: to reject directories and missing files, and to check the
+// handle is still current.  Fstat then answers from it.  Eager opens go
+// straight to hdfsOpenFile and take the length from the stream it returns (see
+// below); an open costs one RPC either way.  The checksum files under /cksums
+// are read internally and never stat'd, so skip them.
+//
+   HandleCache *handles = XrdHdfsSS.OpenHandleCache();
+   if (!(open_flag & O_WRONLY) && (lazy || handles) && strncmp("/cksums", fname, 7)) {
+       if (CoalescedPathInfo(m_fs, fname, m_user, m_stat)) {
+           err_code = ENOENT;
+       } else if (S_ISDIR(m_stat.st_mode)) {
+           err_code = EISDIR;
+       } else {
+           m_stat_valid = true;
+       }
+   }
 
-   if ((fh = hdfsOpenFile(m_fs, fname, open_flag, 0, 0, 0)) == NULL) {
+// Reuse the handle of a recent reader of the same file, if it is unchanged.
+//
+   if (!err_code && m_stat_valid && handles) {
+       HandleCache::Handle handle;
+       std::vector<HandleCache::Handle> released;
+       if (handles->Take(fname, m_user, m_stat, handle, released)) {
+           hadoop_disconnect(m_fs);
+           m_fs = handle.m_fs;
+           fh = handle.m_fh;
+       }
+       CloseHandles(released);
+   }
+
+   if (!err_code && lazy) {
+       m_open_deferred = true;
+   }
+   else if (!err_code && !fh && (fh = Hdfs::OpenFile(m_fs, fname, open_flag, 0, 0, 0)) == NULL) {
        err_code = errno;
-       hdfsFileInfo * fileInfo = hdfsGetPathInfo(m_fs, fname);
-       if (fileInfo != NULL) {
-           if (fileInfo->mKind == kObjectKindDirectory) {
-                   err_code = EISDIR;
+       if (m_stat_valid) {
+           err_code = EEXIST;
+       } else {
+           struct stat info;
+           if (CoalescedPathInfo(m_fs, fname, m_user, info)) {
+               err_code = ENOENT;
+           } else if (S_ISDIR(info.st_mode)) {
+               err_code = EISDIR;
            } else {
                err_code = EEXIST;
            }
-           hdfsFreeFileInfo(fileInfo, 1);
-       } else { 
-           err_code = ENOENT;
        }
+       m_stat_valid = false;
    }
 
 // All done.
@@ -498,6 +852,25 @@ int XrdHdfsFile::Open(const char               *path,      // In
    if (err_code != 0)
        return (err_code > 0) ? -err_code : err_code;
 
+   if (open_flag & O_WRONLY)
+   {
+       m_writable = true;
+       XrdHdfsSS.InvalidatePath(fname);
+
+       // We just created (or truncated) the file, so we know what it looks
+       // like without asking; HDFS applies its default 022 umask to new files.
+       SynthesizeStat(0);
+   }
+   else if (!m_stat_valid && fh && strncmp("/cksums", fname, 7))
+   {
+       // hdfsOpenFile fetched the block locations, so the stream knows the
+       // file's length; at offset 0, that is what is available.  It is an
+       // int, so larger files are left for Fstat to ask the namenode about.
+       int length = Hdfs::Available(m_fs, fh);
+       if (length >= 0 && length < INT_MAX)
+           SynthesizeStat(length);
+   }
+
    if ((open_flag & O_WRONLY) && (strncmp("/cksums", fname, 7)))
    {
        m_state = new ChecksumState(ChecksumManager::ALL);
@@ -520,40 +893,71 @@ int XrdHdfsFile::Close(long long int *)
 */
 {
    static const char *epname = "close";
+   LatencyTimer timer(LatClose);
 
-// Release the handle and return
+// Release the handle and return; closing a file being written flushes it.
 //
    int ret = XrdOssOK;
-   if (fh != NULL  && hdfsCloseFile(m_fs, fh) != 0) {
+   OpContext op(m_writable ? OpWrite : OpMeta, m_user);
+   NoteOp(m_user, fname);
+
+// Keep a handle to a file we only read for the next reader, along with its
+// connection.
+//
+   HandleCache *handles = XrdHdfsSS.OpenHandleCache();
+   if (fh != NULL && !m_writable && m_stat_valid && handles) {
+      HandleCache::Handle handle;
+      handle.m_fs = m_fs;
+      handle.m_fh = fh;
+      handle.m_stat = m_stat;
+      std::vector<HandleCache::Handle> released;
+      handles->Put(fname, m_user, handle, released);
+      CloseHandles(released);
+      m_fs = NULL;
+      fh = NULL;
+   }
+
+   if (fh != NULL  && Hdfs::CloseFile(m_fs, fh) != 0) {
       ret = XrdHdfsSys::Emsg(epname, error, errno, "close", fname);
    }
+   if (fh != NULL && m_writable) {
+      // The file's final size is now visible in its directory's listing.
+      XrdHdfsSS.InvalidatePath(fname);
+   }
    fh = NULL;
+   m_writable = false;
+   m_stat_valid = false;
+   m_open_deferred = false;
 
    XrdSysMutexHelper readbuf_lock(readbuf_mutex);
 
    if (readbuf) {
-       char stats[300];
-       float pct_buf_used = 0;
-       if( readbuf_bytes_loaded > 0 ) {
-           pct_buf_used = 100.0*readbuf_bytes_used/readbuf_bytes_loaded;
-       }
-       snprintf(stats,sizeof(stats),"%u misses, %u hits, %u partial hits, %u unbuffered, %lu buffered bytes used of %lu read (%.2f%%)",
-                readbuf_misses,readbuf_hits,readbuf_partial_hits,readbuf_bypassed,
-                readbuf_bytes_used,readbuf_bytes_loaded,
-                pct_buf_used);
-       XrdHdfsSS.Say("Readahead buffer stats for ", fname, " : ", stats);
+       HDFS_TRACE(Stats, "close", "Readahead buffer stats for %s : %u misses, %u hits, %u partial hits,"
+                  " %u unbuffered, %lu buffered bytes used of %lu read (%.2f%%)",
+                  fname, readbuf_misses, readbuf_hits, readbuf_partial_hits, readbuf_bypassed,
+                  readbuf_bytes_used, readbuf_bytes_loaded,
+                  readbuf_bytes_loaded ? 100.0*readbuf_bytes_used/readbuf_bytes_loaded : 0.0);
 
-      free(readbuf);
+      XrdHdfsSS.ReadBufferPool()->Release(readbuf, readbuf_size);
       readbuf = 0;
       readbuf_size = 0;
       readbuf_offset = 0;
       readbuf_len = 0;
    }
+
+   g_readbuf_hits += readbuf_hits;
+   g_readbuf_partial_hits += readbuf_partial_hits;
+   g_readbuf_misses += readbuf_misses;
+   g_readbuf_bypassed += readbuf_bypassed;
+   readbuf_hits = readbuf_partial_hits = readbuf_misses = readbuf_bypassed = 0;
    readbuf_lock.UnLock();
 
    if (m_state)
    {
-       m_state->Finalize();
+       {
+           LatencyTimer cksum_timer(LatChecksum);
+           m_state->Finalize();
+       }
        if (ret == XrdOssOK) {
            // Only write checksum file if close() was successful
            XrdHdfs::ChecksumManager manager(HdfsEroute);
@@ -573,10 +977,10 @@ int XrdHdfsFile::Close(long long int *)
 
 XrdHdfsFile::~XrdHdfsFile()
 {
-   if (m_fs && fh) {hdfsCloseFile(m_fs, fh);}
+   if (m_fs && fh) {Hdfs::CloseFile(m_fs, fh);}
    if (m_fs) {hadoop_disconnect(m_fs);}
    if (fname) {free(fname);}
-   if (readbuf) {free(readbuf);}
+   if (readbuf) {XrdHdfsSS.ReadBufferPool()->Release(readbuf, readbuf_size);}
    if (m_state) {delete m_state;}
 }
   
@@ -602,18 +1006,26 @@ ssize_t XrdHdfsFile::Read(void   *buff,      // Out
 #ifndef NODEBUG
    static const char *epname = "Read";
 #endif
+   LatencyTimer timer(LatRead);
    ssize_t nbytes;
+   OpContext op(m_cksum_calc ? OpChecksum : OpRead, m_user);
+   NoteOp(m_user, fname);
 
    XrdSysMutexHelper readbuf_lock(readbuf_mutex);
    // There are multiple exit points from this function,
    // so we rely on the fact that readbuf_lock will unlock
    // when it goes out of scope.
 
+   if (m_open_deferred) {
+      int rc = OpenDeferred();
+      if (rc) return XrdHdfsSys::Emsg(epname, error, rc, "open", fname);
+   }
+
    if( blen > readbuf_size ) {
        // request is larger than readbuf, so bypass readbuf and read
        // directly into caller's buffer
       errno = 0;
-      nbytes = hdfsPread(m_fs, fh, (off_t)offset, (void *)buff, (size_t)blen);
+      nbytes = Hdfs::Pread(m_fs, fh, (off_t)offset, (void *)buff, (size_t)blen);
       if ((nbytes == 0) && errno)
       {
           nbytes = -1;
@@ -656,7 +1068,7 @@ ssize_t XrdHdfsFile::Read(void   *buff,      // Out
        // loop in case of short reads
        while( readbuf_len < readbuf_size ) {
            errno = 0;
-           int n = hdfsPread(m_fs, fh, offset + readbuf_len, (void *)(readbuf + readbuf_len), readbuf_size - readbuf_len);
+           int n = Hdfs::Pread(m_fs, fh, offset + readbuf_len, (void *)(readbuf + readbuf_len), readbuf_size - readbuf_len);
            if( n < 0 && errno == EINTR ) {
                continue;
            }
@@ -687,6 +1099,7 @@ ssize_t XrdHdfsFile::Read(void   *buff,      // Out
 
 // Return number of bytes read
 //
+   NoteOpBytes(nbytes);
    return nbytes;
 }
   
@@ -730,6 +1143,7 @@ ssize_t XrdHdfsFile::Write(const void *buff,    // In
 */
 {
    static const char *epname = "write";
+   LatencyTimer timer(LatWrite);
 
     if (offset != m_nextoff)
     {
@@ -737,13 +1151,22 @@ ssize_t XrdHdfsFile::Write(const void *buff,    // In
             " supported by HDFS.", fname);
     }
 
-    ssize_t result = hdfsWrite(m_fs, fh, buff, blen);
-    if (result >= 0) {m_nextoff += result;}
+    OpContext op(OpWrite, m_user);
+    NoteOp(m_user, fname);
+    ssize_t result = Hdfs::Write(m_fs, fh, buff, blen);
+    if (result >= 0)
+    {
+        m_nextoff += result;
+        m_stat.st_size = m_nextoff;
+        m_stat.st_mtime = m_stat.st_ctime = time(NULL);
+    }
 
     if (m_state)
     {
+        LatencyTimer cksum_timer(LatChecksum);
         m_state->Update(static_cast<const unsigned char*>(buff), blen);
     }
+    NoteOpBytes(result);
 
    return result;
 }
@@ -778,26 +1201,22 @@ int XrdHdfsFile::Fstat(struct stat     *buf)         // Out
 */
 {
    static const char *epname = "stat";
+   LatencyTimer timer(LatFstat);
 
-   hdfsFileInfo * fileInfo = hdfsGetPathInfo(m_fs, fname);
-// Execute the function
+// Metadata captured at open (and kept current by Write) is answered from
+// memory; only go to the namenode if we have nothing or were asked to refresh.
 //
-   if (fileInfo == NULL)
-      return XrdHdfsSys::Emsg(epname, error, errno, "stat", fname);
-   buf->st_mode = fileInfo->mPermissions;
-   buf->st_mode |= (fileInfo->mKind == kObjectKindDirectory) ? S_IFDIR : S_IFREG;
-   buf->st_nlink = (fileInfo->mKind == kObjectKindDirectory) ? 0 : 1;
-   buf->st_uid = 1;
-   buf->st_gid = 1;
-   buf->st_size = (fileInfo->mKind == kObjectKindDirectory) ? 4096 : \
-      fileInfo->mSize;
-   buf->st_mtime    = fileInfo->mLastMod;
-   buf->st_atime    = fileInfo->mLastMod;
-   buf->st_ctime    = fileInfo->mLastMod;
-   buf->st_dev      = 0;
-   buf->st_ino      = 1; // XRootD assumes offline status when both dev and ino are zero
-
-   hdfsFreeFileInfo(fileInfo, 1);
+   if (!m_stat_valid) {
+      OpContext op(OpMeta, m_user);
+      NoteOp(m_user, fname);
+      hdfsFileInfo * fileInfo = Hdfs::GetPathInfo(m_fs, fname);
+      if (fileInfo == NULL)
+         return XrdHdfsSys::Emsg(epname, error, errno, "stat", fname);
+      FillStat(*fileInfo, &m_stat);
+      Hdfs::FreeFileInfo(fileInfo, 1);
+      m_stat_valid = true;
+   }
+   memcpy(buf, &m_stat, sizeof(m_stat));
 
 // All went well
 //
@@ -808,6 +1227,27 @@ int XrdHdfsFile::Fstat(struct stat     *buf)         // Out
 /*         F i l e   S y s t e m   O b j e c t   I n t e r f a c e s          */
 /******************************************************************************/
  
+namespace
+{
+   void *WarmUpMain(void *arg)
+   {
+      static_cast<XrdHdfsSys *>(arg)->WarmUp();
+      return NULL;
+   }
+
+   // Whether the data server's warm-up marker at `path` is there and was
+   // written by a server still running, not left behind by an earlier one.
+   bool PeerWarm(const std::string &path)
+   {
+      FILE *fp = fopen(path.c_str(), "r");
+      if (!fp) return false;
+      long pid = 0;
+      bool found = (fscanf(fp, "%ld", &pid) == 1) && pid > 0;
+      fclose(fp);
+      return found && (!kill(static_cast<pid_t>(pid), 0) || errno == EPERM);
+   }
+}
+
 /******************************************************************************/
 /*                                  I n i t                                   */
 /******************************************************************************/
@@ -836,9 +1276,33 @@ int XrdHdfsSys::Init(XrdSysLogger *lp, const char *configfn)
    N2N_Lib=NULL;
    the_N2N=NULL;
    tmp = ((NoGo=Configure(configfn)) ? "failed." : "completed.");
+   g_ns_map = m_ns_map;
    eDest->Say("------ HDFS storage system initialization ", tmp);
    eDest->Emsg("HDFS storage system initialization.", tmp);
 
+// Start the JVM, connections and read path warming up in the background.
+// The cmsd runs a plugin of its own: it only warms up its own connections,
+// and its probes (see Stat) also wait for the data server's marker.
+//
+   const char *prog = getenv("XRDPROG");
+   m_cmsd_fs = prog && !strcmp(prog, "cmsd");
+   if (m_warm_marker.empty() && (tmp = getenv("XRDADMINPATH")) && *tmp) {
+      m_warm_marker = tmp;
+      if (m_warm_marker[m_warm_marker.size()-1] != '/') m_warm_marker += '/';
+      m_warm_marker += ".hdfs_warm";
+   }
+   if (!NoGo && m_warmup) {
+      pthread_t tid;
+      if (!m_cmsd_fs && !m_warm_marker.empty()) unlink(m_warm_marker.c_str());
+      m_warm = false;
+      m_warm_deadline = time(NULL) + m_warmup_hold;
+      if (XrdSysThread::Run(&tid, WarmUpMain, static_cast<void *>(this), 0, "HDFS warm-up")) {
+         eDest->Emsg("Config", errno, "start the warm-up thread");
+         m_warm = true;
+         if (!m_cmsd_fs) PublishWarm();
+      }
+   }
+
 // All done.
 //
    return NoGo;
@@ -850,6 +1314,237 @@ int XrdHdfsSys::Init(XrdSysLogger *lp, const char *configfn)
 
 const char *XrdHdfsSys::getVersion() {return "@devel@";}
 
+/******************************************************************************/
+/*                              g e t S t a t s                               */
+/******************************************************************************/
+
+int XrdHdfsSys::getStats(char *buff, int blen)
+{
+   // Room for the accounting of the busiest users and every prefix.
+   int maxlen = 8192;
+   if (g_accounting) maxlen += (m_ioaccount_top + static_cast<int>(m_io_prefixes.size()) + 2) * 512;
+   if (!buff || blen <= 0) return maxlen;
+
+   unsigned long long cks_calls, cks_collapsed;
+   ChecksumManager::CoalesceCounts(cks_calls, cks_collapsed);
+
+   // Each pooled connection is a Java FileSystem; their cost shows up as heap.
+   long long heap_used = 0, heap_committed = 0, heap_max = 0;
+   JvmHeapUsage(heap_used, heap_committed, heap_max);
+
+   char sched[512];
+   int slen = snprintf(sched, sizeof(sched), "<sched>");
+   for (int idx = 0; g_scheduler && (idx < OpClassCount); idx++) {
+      OpClass cls = static_cast<OpClass>(idx);
+      slen += snprintf(sched + slen, sizeof(sched) - slen,
+                       "<%s><limit>%u</limit><active>%u</active><queued>%u</queued><waits>%llu</waits></%s>",
+                       OpClassName(cls), g_scheduler->Limit(cls), g_scheduler->Active(cls),
+                       g_scheduler->Queued(cls), g_scheduler->Waits(cls), OpClassName(cls));
+      if (slen >= (int)sizeof(sched)) break;
+   }
+   if (slen < (int)sizeof(sched)) snprintf(sched + slen, sizeof(sched) - slen, "</sched>");
+
+   std::string latency = LatencyStats();
+   std::string accounting = g_accounting ? g_accounting->Stats(m_ioaccount_top) : "";
+
+   int len = snprintf(buff, blen,
+      "<stats id=\"hdfs\">"
+      "<negcache><hits>%llu</hits><misses>%llu</misses></negcache>"
+      "<dircache><hits>%llu</hits><misses>%llu</misses><waits>%llu</waits></dircache>"
+      "<statcache><hits>%llu</hits><misses>%llu</misses><prefetch>%llu</prefetch></statcache>"
+      "<connpool><namespaces>%llu</namespaces><users>%llu</users><conns>%llu</conns><evicted>%llu</evicted></connpool>"
+      "<bufpool><inuse>%llu</inuse><cached>%llu</cached><limit>%llu</limit>"
+      "<allocs>%llu</allocs><reuses>%llu</reuses><degraded>%llu</degraded><failed>%llu</failed></bufpool>"
+      "<readbuf><hits>%llu</hits><partial>%llu</partial><misses>%llu</misses><bypassed>%llu</bypassed></readbuf>"
+      "<handlecache><size>%llu</size><hits>%llu</hits><misses>%llu</misses><stale>%llu</stale></handlecache>"
+      "<jniworkers><calls>%llu</calls></jniworkers>%s"
+      "<jvm><heapused>%lld</heapused><heapcommitted>%lld</heapcommitted><heapmax>%lld</heapmax></jvm>"
+      "<coalesce><stat><calls>%llu</calls><collapsed>%llu</collapsed></stat>"
+      "<cksum><calls>%llu</calls><collapsed>%llu</collapsed></cksum></coalesce>"
+      "<latency>%s</latency>%s"
+      "<warmup><ready>%d</ready><ms>%lld</ms></warmup>"
+      "</stats>",
+      m_neg_cache ? m_neg_cache->Hits() : 0ULL, m_neg_cache ? m_neg_cache->Misses() : 0ULL,
+      m_dir_cache ? m_dir_cache->Hits() : 0ULL, m_dir_cache ? m_dir_cache->Misses() : 0ULL,
+      m_dir_cache ? m_dir_cache->Waits() : 0ULL,
+      m_stat_cache ? m_stat_cache->Hits() : 0ULL, m_stat_cache ? m_stat_cache->Misses() : 0ULL,
+      m_stat_cache ? m_stat_cache->Prefetches() : 0ULL,
+      m_ns_map ? (unsigned long long)m_ns_map->Namespaces() : 0ULL,
+      m_ns_map ? (unsigned long long)m_ns_map->Users() : 0ULL,
+      m_ns_map ? (unsigned long long)m_ns_map->Connections() : 0ULL,
+      m_ns_map ? m_ns_map->Evictions() : 0ULL,
+      m_buf_pool ? (unsigned long long)m_buf_pool->InUse() : 0ULL,
+      m_buf_pool ? (unsigned long long)m_buf_pool->Cached() : 0ULL,
+      m_buf_pool ? (unsigned long long)m_buf_pool->Budget() : 0ULL,
+      m_buf_pool ? m_buf_pool->Allocations() : 0ULL, m_buf_pool ? m_buf_pool->Reuses() : 0ULL,
+      m_buf_pool ? m_buf_pool->Degraded() : 0ULL, m_buf_pool ? m_buf_pool->Failures() : 0ULL,
+      (unsigned long long)g_readbuf_hits, (unsigned long long)g_readbuf_partial_hits,
+      (unsigned long long)g_readbuf_misses, (unsigned long long)g_readbuf_bypassed,
+      m_handle_cache ? (unsigned long long)m_handle_cache->Size() : 0ULL,
+      m_handle_cache ? m_handle_cache->Hits() : 0ULL, m_handle_cache ? m_handle_cache->Misses() : 0ULL,
+      m_handle_cache ? m_handle_cache->Stale() : 0ULL,
+      g_jni_workers ? g_jni_workers->Calls() : 0ULL, sched,
+      heap_used, heap_committed, heap_max,
+      g_pathinfo_flight.Calls(), g_pathinfo_flight.Collapsed(),
+      cks_calls, cks_collapsed, latency.c_str(), accounting.c_str(),
+      m_warm ? 1 : 0, m_warm_ms.load());
+   if (len < 0) return 0;
+   return (len < blen) ? len : blen - 1;
+}
+
+void
+XrdHdfsSys::LogStats()
+{
+   std::vector<std::string> lines;
+   LatencyReport(lines);
+   for (size_t idx = 0; idx < lines.size(); idx++)
+      eDest->Say("hdfs latency ", lines[idx].c_str());
+
+   if (!g_accounting) return;
+   lines.clear();
+   g_accounting->Report(lines);
+   for (size_t idx = 0; idx < lines.size(); idx++)
+      eDest->Say("hdfs io ", lines[idx].c_str());
+}
+
+/******************************************************************************/
+/*                                W a r m U p                                 */
+/******************************************************************************/
+
+/*
+  Function: Get the plugin ready for its first clients: start the JVM, open
+            the pooled connections of the cmsd and of the configured users
+            in every namespace, and read a little of the configured file.
+            In the cmsd, only open its own connections, then wait (up to the
+            hold) for the data server to publish that it is ready.
+
+  Output:   None; failures are logged, and the server is marked ready anyway.
+*/
+void
+XrdHdfsSys::WarmUp()
+{
+   struct timespec start, now;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   int failed = 0;
+
+   std::vector<std::string> paths(1, "/");
+   for (size_t idx = 0; idx < m_ns_routes.size(); idx++)
+      paths.push_back(m_ns_routes[idx].first);
+   std::vector<std::string> users(1, "root");
+   if (!m_cmsd_fs)
+      users.insert(users.end(), m_warmup_users.begin(), m_warmup_users.end());
+
+// Pooled connections stay open once released; the first metadata call on
+// each also sets up its RPC client to the namenode.
+//
+   for (size_t uidx = 0; uidx < users.size(); uidx++) {
+      OpContext op(uidx ? OpMeta : OpCmsdMeta, users[uidx]);
+      for (size_t pidx = 0; pidx < paths.size(); pidx++) {
+         hdfsFS fs = hadoop_connect(paths[pidx].c_str(), users[uidx].c_str());
+         if (!fs) {
+            eDest->Emsg("WarmUp", errno ? errno : EIO, "connect as", users[uidx].c_str());
+            failed++;
+            continue;
+         }
+         hdfsFileInfo *info = Hdfs::GetPathInfo(fs, paths[pidx].c_str());
+         if (info) {
+            Hdfs::FreeFileInfo(info, 1);
+         } else {
+            eDest->Emsg("WarmUp", errno ? errno : EIO, "stat", paths[pidx].c_str());
+            failed++;
+         }
+         hadoop_disconnect(fs);
+      }
+   }
+
+// Exercise the read path through to the datanodes.
+//
+   if (!m_cmsd_fs && !m_warmup_file.empty()) {
+      OpContext op(OpRead, "root");
+      hdfsFS fs = hadoop_connect(m_warmup_file.c_str(), "root");
+      hdfsFile fh = fs ? Hdfs::OpenFile(fs, m_warmup_file.c_str(), O_RDONLY, 0, 0, 0) : NULL;
+      char buff[4096];
+      if (!fh || (Hdfs::Pread(fs, fh, 0, buff, sizeof(buff)) < 0)) {
+         eDest->Emsg("WarmUp", errno ? errno : EIO, "read", m_warmup_file.c_str());
+         failed++;
+      }
+      if (fh) Hdfs::CloseFile(fs, fh);
+      if (fs) hadoop_disconnect(fs);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   long long msecs = (now.tv_sec - start.tv_sec) * 1000LL + (now.tv_nsec - start.tv_nsec) / 1000000;
+   char msg[64];
+   snprintf(msg, sizeof(msg), "%lld ms with %d failure%s.", msecs, failed, failed == 1 ? "" : "s");
+   eDest->Say("------ HDFS warm-up completed in ", msg);
+
+// The data server tells the cmsd it is ready; the cmsd waits to be told.
+//
+   if (!m_cmsd_fs) {
+      PublishWarm();
+   } else if (m_warm_marker.empty()) {
+      eDest->Say("------ HDFS warm-up cannot see the data server; only the hold applies.");
+   } else {
+      while (!PeerWarm(m_warm_marker) && time(NULL) < m_warm_deadline)
+         XrdSysTimer::Snooze(1);
+      if (!PeerWarm(m_warm_marker))
+         eDest->Emsg("WarmUp", "data server not ready after hold; no marker at", m_warm_marker.c_str());
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      msecs = (now.tv_sec - start.tv_sec) * 1000LL + (now.tv_nsec - start.tv_nsec) / 1000000;
+   }
+
+   m_warm_cond.Lock();
+   m_warm_ms = msecs;
+   m_warm = true;
+   m_warm_cond.Broadcast();
+   m_warm_cond.UnLock();
+}
+
+/*
+  Function: Tell the cmsd the data server is warm: write our pid to the
+            marker file, if there is one, atomically.
+*/
+void
+XrdHdfsSys::PublishWarm()
+{
+   if (m_warm_marker.empty()) return;
+   std::string tmp_path = m_warm_marker + ".tmp";
+   FILE *fp = fopen(tmp_path.c_str(), "w");
+   bool ok = fp && fprintf(fp, "%ld\n", static_cast<long>(getpid())) > 0;
+   if (fp && fclose(fp)) ok = false;
+   if (!ok || rename(tmp_path.c_str(), m_warm_marker.c_str())) {
+      eDest->Emsg("WarmUp", errno ? errno : EIO, "write warm-up marker", m_warm_marker.c_str());
+      unlink(tmp_path.c_str());
+   }
+}
+
+/*
+  Function: Wait for the warm-up to finish, but not past its deadline, so a
+            namenode which never answers does not hold the cmsd forever.
+*/
+void
+XrdHdfsSys::WaitWarm()
+{
+   m_warm_cond.Lock();
+   while (!m_warm) {
+      time_t left = m_warm_deadline - time(NULL);
+      if (left <= 0) break;
+      m_warm_cond.Wait(static_cast<int>(left));
+   }
+   m_warm_cond.UnLock();
+}
+
+void
+XrdHdfsSys::Sweep()
+{
+   if (m_handle_cache) {
+      std::vector<HandleCache::Handle> released;
+      m_handle_cache->Sweep(released);
+      CloseHandles(released);
+   }
+   if (m_ns_map) m_ns_map->Sweep();
+}
+
 void
 XrdHdfsSys::Say(char const *msg, char const *x, char const *y, char const *z)
 {
@@ -859,11 +1554,12 @@ XrdHdfsSys::Say(char const *msg, char const *x, char const *y, char const *z)
 char *
 XrdHdfsSys::GetRealPath(const char *path)
 {
+   LatencyTimer timer(LatN2N);
    char *fname;
    if (the_N2N) {
        char actual_path[XrdHdfsMAX_PATH_LEN+1];
        if ((the_N2N)->lfn2pfn(path, actual_path, sizeof(actual_path))) {
-          eDest->Say("Cannot find a N2N mapping for ", path, "; using path directly.");
+          HDFS_TRACE(N2N, "n2n", "Cannot find a N2N mapping for %s; using path directly.", path);
           fname = strdup(path);
        } else {
           fname = strdup(actual_path);
@@ -874,6 +1570,34 @@ XrdHdfsSys::GetRealPath(const char *path)
    return fname;
 }
 
+void
+XrdHdfsSys::InvalidatePath(const char *path)
+{
+   if (!path) return;
+   if (m_neg_cache) m_neg_cache->Clear(path);
+   if (m_dir_cache) {
+      // The path may itself be a cached directory, and its parent's listing
+      // holds its name and stat data.
+      m_dir_cache->Invalidate(path);
+      m_dir_cache->Invalidate(ParentPath(path));
+   }
+   if (m_stat_cache) m_stat_cache->Invalidate(path);
+   if (m_handle_cache) {
+      std::vector<HandleCache::Handle> released;
+      m_handle_cache->Invalidate(path, released);
+      CloseHandles(released);
+   }
+}
+
+void
+XrdHdfsSys::InvalidateTree(const char *path)
+{
+   if (!path) return;
+   InvalidatePath(path);
+   if (m_dir_cache) m_dir_cache->InvalidateTree(path);
+   if (m_stat_cache) m_stat_cache->InvalidateTree(path);
+}
+
 int XrdHdfsSys::Lfn2Pfn(const char *oldp, char *newp, int blen)
 {
     if (the_N2N) return -(the_N2N->lfn2pfn(oldp, newp, blen));
@@ -910,13 +1634,23 @@ int XrdHdfsSys::Stat(const  char    *path,    // In
 */
 {
    static const char *epname = "stat";
+   LatencyTimer timer(LatStat);
    int retc = XrdOssOK;
    char * fname;
-   hdfsFileInfo * fileInfo = NULL;
+   std::string user = client ? ExtractAuthName(client) : "root", parent;
+   OpContext op(client ? OpMeta : OpCmsdMeta, user);
+
+// Until warmed up, do not tell the cmsd we have anything; redirected
+// clients would wait on the JVM and namenode connections instead.  In the
+// cmsd this covers the data server's warm-up too (see WarmUp).
+//
+   if (!client && !m_warm) WaitWarm();
 
    fname = GetRealPath(path);
+   NoteOp(user, fname);
    if (!fname) {
        retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "stat", path);
+       return retc;
    }
 
 // Get the security name, and connect with it
@@ -924,55 +1658,53 @@ int XrdHdfsSys::Stat(const  char    *path,    // In
 //   network, things should act as the superuser -- but only for 'stat'
 //   (not Open or OpenDir - those should remain 'nobody'!).
 //
-//   Further, we don't want to connect / disconnect repeatedly for the cmsd;
-//   instead, we keep a static instance.
+//   Connections are pooled, so the cmsd does not connect / disconnect
+//   repeatedly either.
    hdfsFS fs = NULL;
-   if (client) {
-      fs = hadoop_connect(client);
-      if (fs == NULL) {
-         retc = XrdHdfsSys::Emsg(epname, error, EIO, "stat", fname);
+   if (!client) {
+      // The cmsd asks about many files we do not have; answer repeated
+      // probes for recently-missing paths without contacting the namenode.
+      if (m_neg_cache && m_neg_cache->Lookup(fname)) {
+         errno = ENOENT;
+         retc = -ENOENT;
+         error.setErrInfo(ENOENT, "No such file or directory");
          goto cleanup;
       }
-   } else {
-      XrdSysMutexHelper fs_lock(m_fs_mutex);
-      if (m_cmsd_fs == NULL) {
-         m_cmsd_fs = hadoop_connect("default", 0, "root");
-         if (m_cmsd_fs == NULL) {
-            retc = XrdHdfsSys::Emsg(epname, error, EIO, "stat", fname);
-            goto cleanup;
-         }
-      }
-      fs = m_cmsd_fs;
+   }
+   fs = hadoop_connect(fname, user.c_str());
+   if (fs == NULL) {
+      retc = XrdHdfsSys::Emsg(epname, error, EIO, "stat", fname);
+      goto cleanup;
    }
 
-   fileInfo = hdfsGetPathInfo(fs, fname);
+// Answer from the stat cache if a recent prefetch covered this path.
+// Otherwise note the miss; if the parent directory is seeing a burst of
+// stats, list it once to fill the cache for all of its children.
+//
+   if (m_stat_cache) {
+      if (m_stat_cache->Lookup(fname, user, *buf)) goto cleanup;
+      parent = ParentPath(fname);
+      if (m_stat_cache->NoteMiss(parent, user)) {
+         bool too_big = PrefetchStats(*m_stat_cache, fs, parent, user);
+         m_stat_cache->PrefetchDone(parent, user, too_big);
+         if (m_stat_cache->Lookup(fname, user, *buf)) goto cleanup;
+      }
+   }
 
-// Execute the function
+// Execute the function; identical concurrent stats share one namenode RPC.
 //
-   if (fileInfo == NULL) {
-      retc = XrdHdfsSys::Emsg(epname, error, errno, "stat", fname);
+   if ((retc = CoalescedPathInfo(fs, fname, user, *buf))) {
+      if (!client && m_neg_cache && (retc == ENOENT)) {
+         m_neg_cache->Insert(fname);
+      }
+      retc = XrdHdfsSys::Emsg(epname, error, retc, "stat", fname);
       goto cleanup;
    }
 
-   buf->st_mode = fileInfo->mPermissions;
-   buf->st_mode |= (fileInfo->mKind == kObjectKindDirectory) ? S_IFDIR : S_IFREG;
-   buf->st_nlink = (fileInfo->mKind == kObjectKindDirectory) ? 0 : 1;
-   buf->st_uid = 1;
-   buf->st_gid = 1;
-   buf->st_size = (fileInfo->mKind == kObjectKindDirectory) ? 4096 : \
-      fileInfo->mSize;
-   buf->st_mtime    = fileInfo->mLastMod;
-   buf->st_atime    = fileInfo->mLastMod;
-   buf->st_ctime    = fileInfo->mLastMod;
-   buf->st_dev      = 0;
-   buf->st_ino      = 1; // XRootD assumes offline status when both dev and ino are zero
-
-   hdfsFreeFileInfo(fileInfo, 1);
-
 // All went well
 //
 cleanup:
-   if (client && fs)
+   if (fs)
       hadoop_disconnect(fs);
    if (fname)
       free(fname);
@@ -984,26 +1716,30 @@ int
 XrdHdfsSys::Chmod(const char *req_fname, mode_t mode, XrdOucEnv *envp)
 {
     static const char *epname = "chmod";
+    LatencyTimer timer(LatChmod);
     int retc = XrdOssOK;
+    OpContext op(OpMeta, ExtractAuthName(envp));
     hdfsFS fs = NULL;
 
     char *fname = GetRealPath(req_fname);
+    NoteOp(op.m_user, fname);
     if (!fname) {
         retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "chmod", req_fname);
         goto cleanup;
     }
 
-    fs = hadoop_connect(envp);
+    fs = hadoop_connect(envp, fname);
     if (fs == NULL) {
         retc = XrdHdfsSys::Emsg(epname, error, EIO, "chmod", fname);
         goto cleanup;
     }
 
     errno = 0;
-    if (-1 == hdfsChmod(fs, fname, mode)) {
+    if (-1 == Hdfs::Chmod(fs, fname, mode)) {
         retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : EIO, "chmod", fname);
         goto cleanup;
     }
+    InvalidatePath(fname);
 
 cleanup:
     hadoop_disconnect(fs);
@@ -1016,16 +1752,19 @@ XrdHdfsSys::Mkdir(const char *req_path, mode_t mode, int mkpath,
                   XrdOucEnv *envp)
 {
     static const char *epname = "mkdir";
+    LatencyTimer timer(LatMkdir);
     int retc = XrdOssOK;
+    OpContext op(OpMeta, ExtractAuthName(envp));
     hdfsFS fs = NULL;
 
     char *path = GetRealPath(req_path);
+    NoteOp(op.m_user, path);
     if (!path) {
         retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "mkdir", req_path);
         goto cleanup;
     }
 
-    fs = hadoop_connect(envp);
+    fs = hadoop_connect(envp, path);
     if (fs == NULL) {
         retc = XrdHdfsSys::Emsg(epname, error, EIO, "mkdir", path);
         goto cleanup;
@@ -1053,7 +1792,7 @@ XrdHdfsSys::Mkdir(const char *req_path, mode_t mode, int mkpath,
             char old_value = *parent_dir;
             *parent_dir = '\0';
             errno = 0;
-            int retval = hdfsExists(fs, path);
+            int retval = Hdfs::Exists(fs, path);
             *parent_dir = old_value;
             if (retval) {
                 retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : ENOENT,
@@ -1064,24 +1803,30 @@ XrdHdfsSys::Mkdir(const char *req_path, mode_t mode, int mkpath,
     }
 
     errno = 0;
-    if (-1 == hdfsCreateDirectory(fs, path)) {
+    if (-1 == Hdfs::CreateDirectory(fs, path)) {
         retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : EIO, "mkdir", path);
         goto cleanup;
     }
+    InvalidatePath(path);
+    // With mkpath, the missing parents were created too.
+    if (mkpath) {
+        for (std::string parent = ParentPath(path); !parent.empty(); parent = ParentPath(parent.c_str()))
+            InvalidatePath(parent.c_str());
+    }
 
     if (MKDIR_PERFORM_CHMOD && mode) {
         errno = 0;
-        hdfsFileInfo *fileInfo = hdfsGetPathInfo(fs, path);
+        hdfsFileInfo *fileInfo = Hdfs::GetPathInfo(fs, path);
         if (NULL == fileInfo) {
             retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : ENOENT,
                                         "stat", path);
             goto cleanup;
         }
         mode_t curmode = fileInfo->mPermissions;
-        hdfsFreeFileInfo(fileInfo, 1);
+        Hdfs::FreeFileInfo(fileInfo, 1);
 
         errno = 0;
-        if ((curmode != mode) && (-1 == hdfsChmod(fs, path, mode))) {
+        if ((curmode != mode) && (-1 == Hdfs::Chmod(fs, path, mode))) {
             retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : EIO, "chmod",
                                     path);
             goto cleanup;
@@ -1098,16 +1843,19 @@ int
 XrdHdfsSys::Remdir(const char *req_path, int /*opts*/, XrdOucEnv *envp)
 {
     static const char *epname = "rmdir";
+    LatencyTimer timer(LatRemdir);
     int retc = XrdOssOK;
+    OpContext op(OpMeta, ExtractAuthName(envp));
     hdfsFS fs = NULL;
 
     char *path = GetRealPath(req_path);
+    NoteOp(op.m_user, path);
     if (!path) {
         retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "rmdir", req_path);
         goto cleanup;
     }
 
-    fs = hadoop_connect(envp);
+    fs = hadoop_connect(envp, path);
     if (fs == NULL) {
         retc = XrdHdfsSys::Emsg(epname, error, EIO, "rmdir", path);
         goto cleanup;
@@ -1115,10 +1863,11 @@ XrdHdfsSys::Remdir(const char *req_path, int /*opts*/, XrdOucEnv *envp)
 
     // TODO: Bail out if the parent directory doesn't exist and mkpath isn't set.
     errno = 0;
-    if (-1 == hdfsDelete(fs, path, 0)) {
+    if (-1 == Hdfs::Delete(fs, path, 0)) {
         retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : EIO, "rmdir", path);
         goto cleanup;
     }
+    InvalidateTree(path);
 
 cleanup:
     hadoop_disconnect(fs);
@@ -1131,10 +1880,13 @@ XrdHdfsSys::Rename(const char *req_src, const char *req_dest,
                    XrdOucEnv *envp_src, XrdOucEnv * /*envp_dest*/)
 {
     static const char *epname = "rename";
+    LatencyTimer timer(LatRename);
     int retc = XrdOssOK;
+    OpContext op(OpMeta, ExtractAuthName(envp_src));
     hdfsFS fs = NULL;
 
     char *src = GetRealPath(req_src), *dest = NULL;
+    NoteOp(op.m_user, src);
     if (!src) {
         retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "rename", req_src);
         goto cleanup;
@@ -1146,17 +1898,25 @@ XrdHdfsSys::Rename(const char *req_src, const char *req_dest,
 
     // NOTE: hdfsMove has the concept of moving between filesystems.  Not clear if it has
     // the right semantics for the XRootD use case, however.
-    fs = hadoop_connect(envp_src);
+    if (g_ns_map && !g_ns_map->SameNamespace(src, dest)) {
+        retc = XrdHdfsSys::Emsg(epname, error, EXDEV, "rename", src);
+        goto cleanup;
+    }
+    fs = hadoop_connect(envp_src, src);
     if (fs == NULL) {
         retc = XrdHdfsSys::Emsg(epname, error, EIO, "rename", src);
         goto cleanup;
     }
 
     errno = 0;
-    if (-1 == hdfsRename(fs, src, dest)) {
+    if (-1 == Hdfs::Rename(fs, src, dest)) {
         retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : EIO, "rmdir", src);
         goto cleanup;
     }
+    // Either may be a directory: what was below src has moved, and HDFS
+    // moves src into dest if that is an existing directory.
+    InvalidateTree(src);
+    InvalidateTree(dest);
 
 cleanup:
     hadoop_disconnect(fs);
@@ -1169,31 +1929,35 @@ int
 XrdHdfsSys::Truncate(const char *req_path, long long unsigned int newsize, XrdOucEnv *envp)
 {
     static const char *epname = "truncate";
+    LatencyTimer timer(LatTruncate);
     int retc = XrdOssOK;
+    OpContext op(OpMeta, ExtractAuthName(envp));
     hdfsFS fs = NULL;
     hdfsFile fp = NULL;
 
     char *path = GetRealPath(req_path);
+    NoteOp(op.m_user, path);
     if (!path) {
         retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "truncate", req_path);
         goto cleanup;
     }
 
-    fs = hadoop_connect(envp);
+    fs = hadoop_connect(envp, path);
     if (fs == NULL) {
         retc = XrdHdfsSys::Emsg(epname, error, EIO, "truncate", path);
         goto cleanup;
     }
 
     errno = 0;
-    fp = hdfsOpenFile(fs, path, O_WRONLY, 0, 0, 0);
+    fp = Hdfs::OpenFile(fs, path, O_WRONLY, 0, 0, 0);
     if (NULL == fp) {
         retc = XrdHdfsSys::Emsg(epname, error, errno, "truncate", path);
         goto cleanup;
     }
+    InvalidatePath(path);
 
 cleanup:
-    if (fs && fp) {hdfsCloseFile(fs, fp);}
+    if (fs && fp) {Hdfs::CloseFile(fs, fp);}
     hadoop_disconnect(fs);
     free(path);
     return retc;
@@ -1203,26 +1967,29 @@ int
 XrdHdfsSys::Unlink(const char *req_path, int /*opts*/, XrdOucEnv *envp)
 {
     static const char *epname = "unlink";
+    LatencyTimer timer(LatUnlink);
     int retc = XrdOssOK;
+    OpContext op(OpMeta, ExtractAuthName(envp));
     hdfsFS fs = NULL;
 
     char *path = GetRealPath(req_path);
+    NoteOp(op.m_user, path);
     if (!path) {
         retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "unlink", req_path);
         goto cleanup;
     }
 
-    fs = hadoop_connect(envp);
+    fs = hadoop_connect(envp, path);
     if (fs == NULL) {
         retc = XrdHdfsSys::Emsg(epname, error, EIO, "unlink", path);
         goto cleanup;
     }
 
     errno = 0;
-    if (-1 == hdfsDelete(fs, path, 0)) {
+    if (-1 == Hdfs::Delete(fs, path, 0)) {
         if (errno == EIO) {
             errno = 0;
-            if (-1 == hdfsExists(fs, path)) {
+            if (-1 == Hdfs::Exists(fs, path)) {
                 if (!errno) {
                     errno = ENOENT;
                 }
@@ -1231,6 +1998,7 @@ XrdHdfsSys::Unlink(const char *req_path, int /*opts*/, XrdOucEnv *envp)
         retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : EIO, "unlink", path);
         goto cleanup;
     }
+    InvalidatePath(path);
 
 cleanup:
     hadoop_disconnect(fs);
@@ -1243,37 +2011,41 @@ XrdHdfsSys::Create(const char *tident, const char *req_path, mode_t mode,
                    XrdOucEnv &envp, int opts)
 {
     static const char *epname = "create";
+    LatencyTimer timer(LatCreate);
     int retc = XrdOssOK;
+    OpContext op(OpMeta, ExtractAuthName(&envp));
     hdfsFS fs = NULL;
     hdfsFile fp = NULL;
 
     char *path = GetRealPath(req_path);
+    NoteOp(op.m_user, path);
     if (!path) {
         retc = XrdHdfsSys::Emsg(epname, error, ENOMEM, "create", req_path);
         goto cleanup;
     }
 
-    fs = hadoop_connect(&envp);
+    fs = hadoop_connect(&envp, path);
     if (fs == NULL) {
         retc = XrdHdfsSys::Emsg(epname, error, EIO, "create", path);
         goto cleanup;
     }
 
     errno = 0;
-    fp = hdfsOpenFile(fs, path, O_WRONLY, 0, 0, 0);
+    fp = Hdfs::OpenFile(fs, path, O_WRONLY, 0, 0, 0);
     if (NULL == fp) {
         retc = XrdHdfsSys::Emsg(epname, error, errno, "create", path);
         goto cleanup;
     }
+    InvalidatePath(path);
 
-    if (-1 == hdfsChmod(fs, path, mode)) {
+    if (-1 == Hdfs::Chmod(fs, path, mode)) {
         retc = XrdHdfsSys::Emsg(epname, error, errno ? errno : EIO, "create",
                                 path);
         goto cleanup;
     }
 
 cleanup:
-    if (fs && fp) {hdfsCloseFile(fs, fp);}
+    if (fs && fp) {Hdfs::CloseFile(fs, fp);}
     hadoop_disconnect(fs);
     free(path);
     return retc;
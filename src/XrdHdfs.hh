@@ -15,6 +15,13 @@
 #include <sys/types.h>
 #include <string.h>
 #include <dirent.h>
+#include <time.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
  
 #include "XrdOuc/XrdOucErrInfo.hh"
 #include "XrdOuc/XrdOucName2Name.hh"
@@ -25,6 +32,8 @@
 
 #include "hdfs.h"
 
+#include "XrdHdfsSched.hh"
+
 
 class XrdSfsAio;
 class XrdSysLogger;
@@ -32,6 +41,14 @@ class XrdSysLogger;
 namespace XrdHdfs
 {
     class ChecksumState;
+    class NegativeCache;
+    class DirectoryStream;
+    class DirCache;
+    class StatCache;
+    class NamespaceMap;
+    class BufferPool;
+    class HandleCache;
+    struct DirListing;
 }
 
 #define XrdHdfsMAX_PATH_LEN 1024
@@ -67,6 +84,15 @@ bool           isopen;
 // automatically populate this with the entry's "Stat" information.  This allows
 // Xrootd to save a corresponding call to `Stat` for each directory entry.
 struct stat *m_stat_buf;
+
+// Non-NULL when the listing is streamed page by page rather than held in dh.
+XrdHdfs::DirectoryStream *m_stream;
+
+// Set when the listing comes from (or was published to) the shared cache.
+std::shared_ptr<const XrdHdfs::DirListing> m_listing;
+
+// The identity the directory was opened as.
+std::string m_user;
 };
 
 /******************************************************************************/
@@ -127,6 +153,14 @@ hdfsFile fh; // File Handle
 char *fname; // File Name
 ssize_t m_nextoff; // Next offset for writes.
 
+struct stat m_stat; // Metadata captured at open and maintained by Write.
+bool m_stat_valid;  // If false, Fstat must ask the namenode.
+bool m_writable;    // Opened for writing.
+bool m_open_deferred; // Lazy open: the file and read buffer await the first Read.
+
+std::string m_user; // The identity the file was opened as.
+bool m_cksum_calc;  // Opened by the checksum manager to compute a checksum.
+
 char *readbuf;        // Read buffer
 size_t readbuf_size;  // Memory allocated to readbuf
 off_t readbuf_offset; // Offset in file of beginning of readbuf
@@ -147,6 +181,8 @@ XrdSysMutex readbuf_mutex;
     XrdHdfs::ChecksumState *m_state;
 
     bool Connect(const XrdOucEnv &);
+    int  OpenDeferred();
+    void SynthesizeStat(off_t size);
 };
 
 /******************************************************************************/
@@ -178,7 +214,7 @@ public:
 
         int            Init(XrdSysLogger *, const char *);
 
-        int            getStats(char *buff, int blen) {return 0;}
+        int            getStats(char *buff, int blen);
 
 const   char          *getVersion();
 
@@ -206,10 +242,46 @@ static  int            Emsg(const char *, XrdOucErrInfo&, int, const char *x,
 
 char * GetRealPath(const char *);  // Given a requested pathname, translate it to the HDFS path.  Caller must free() returned space.
 
+void   InvalidatePath(const char *);  // Forget cached metadata for an HDFS path we just created or modified.
+void   InvalidateTree(const char *);  // Likewise for a directory renamed or removed, and all below it.
+
+bool   PagedListing() const {return m_dirlist_paged;}
+
+XrdHdfs::DirCache *DirListingCache() {return m_dir_cache;}
+
+XrdHdfs::BufferPool *ReadBufferPool() {return m_buf_pool;}
+size_t ReadBufferSize() const {return m_bufpool_size;}
+
+XrdHdfs::HandleCache *OpenHandleCache() {return m_handle_cache;}
+
+bool   LazyOpen() const {return m_lazy_open;}
+
+void   LogStats();  // Log the periodic summary of latencies and I/O accounting.
+void   Sweep();     // Close expired cached handles and idle pooled connections.
+
+bool   Warm() const {return m_warm;}  // False while the warm-up started by Init runs.
+void   WarmUp();    // Connect and read ahead of the first clients; run by Init's thread.
+
 virtual int            Lfn2Pfn(const char *Path, char *buff, int blen);
 virtual const char    *Lfn2Pfn(const char *Path, char *buff, int blen, int &rc);
 
-XrdHdfsSys() : XrdOss() {}
+XrdHdfsSys() : XrdOss(), m_negcache_ttl(0), m_negcache_size(65536),
+               m_neg_cache(NULL), m_dirlist_paged(false),
+               m_dircache_ttl(0), m_dircache_size(262144), m_dircache_shared(false),
+               m_dir_cache(NULL), m_statcache_ttl(0), m_statcache_size(262144),
+               m_statcache_burst(4), m_stat_cache(NULL),
+               m_connpool_peruser(4), m_connpool_maxusers(1024),
+               m_connpool_idle(600), m_ns_map(NULL), m_jni_workers(0),
+               m_sched_limits(), m_bufpool_size(32768),
+               m_bufpool_limit(1024*1024*1024), m_bufpool_huge(0),
+               m_buf_pool(NULL), m_handlecache_ttl(0),
+               m_handlecache_size(1024), m_handle_cache(NULL),
+               m_lazy_open(false), m_backend_native(false),
+               m_latency_enabled(true), m_statslog_interval(0),
+               m_slowlog_threshold(0), m_ioaccount(false),
+               m_ioaccount_maxusers(1024), m_ioaccount_top(20),
+               m_trace_rate(100), m_warmup(false), m_warmup_hold(60),
+               m_cmsd_fs(false), m_warm(true), m_warm_ms(0), m_warm_deadline(0), m_warm_cond(0) {}
 virtual ~XrdHdfsSys() {}
 
 private:
@@ -224,12 +296,116 @@ int    ConfigN2N();
 int    ConfigProc(const char *);
 int    ConfigXeq(char *, XrdOucStream &);
 int    xnml(XrdOucStream &Config);
-
-// Static instance of the HDFS filesystem; this is used by the cmsd in order
-// to avoid opening / closing the filesystem repeatedly (reduces the number of
-// new connections to the namenode).
-static XrdSysMutex m_fs_mutex;
-static hdfsFS m_cmsd_fs;
+int    xnegc(XrdOucStream &Config);
+int    xdirl(XrdOucStream &Config);
+int    xdirc(XrdOucStream &Config);
+int    xstpf(XrdOucStream &Config);
+int    xcpool(XrdOucStream &Config);
+int    xjniw(XrdOucStream &Config);
+int    xsched(XrdOucStream &Config);
+int    xbufp(XrdOucStream &Config);
+int    xhndc(XrdOucStream &Config);
+int    xlazy(XrdOucStream &Config);
+int    xnspc(XrdOucStream &Config);
+int    xbknd(XrdOucStream &Config);
+int    xlatn(XrdOucStream &Config);
+int    xstlg(XrdOucStream &Config);
+int    xslow(XrdOucStream &Config);
+int    xioac(XrdOucStream &Config);
+int    xiopf(XrdOucStream &Config);
+int    xtrace(XrdOucStream &Config);
+int    xwarm(XrdOucStream &Config);
+
+void   WaitWarm();
+void   PublishWarm();
+
+// Negative lookup cache for cmsd existence probes; NULL if disabled.
+int                    m_negcache_ttl;
+int                    m_negcache_size;
+XrdHdfs::NegativeCache *m_neg_cache;
+
+// If true, Opendir streams listings in pages instead of using hdfsListDirectory.
+bool                   m_dirlist_paged;
+
+// Shared cache of directory listings; NULL if disabled.
+int                    m_dircache_ttl;
+int                    m_dircache_size;
+bool                   m_dircache_shared;
+XrdHdfs::DirCache     *m_dir_cache;
+
+// Stat results prefetched by listing directories; NULL if disabled.
+int                    m_statcache_ttl;
+int                    m_statcache_size;
+int                    m_statcache_burst;
+XrdHdfs::StatCache    *m_stat_cache;
+
+// Per-user pools of hdfsFS connections, one set per federation namespace;
+// m_ns_routes holds the (path prefix, namenode) of each configured namespace.
+int                    m_connpool_peruser;
+int                    m_connpool_maxusers;
+int                    m_connpool_idle;
+std::vector<std::pair<std::string, std::string> > m_ns_routes;
+XrdHdfs::NamespaceMap *m_ns_map;
+
+// Number of dedicated threads making libhdfs calls; 0 to call directly.
+int                    m_jni_workers;
+
+// Concurrency limit for libhdfs calls of each class; 0 for none.
+unsigned               m_sched_limits[XrdHdfs::OpClassCount];
+
+// Pool of per-file read buffers, capped at m_bufpool_limit bytes in total.
+size_t                 m_bufpool_size;
+long long              m_bufpool_limit;
+int                    m_bufpool_huge;
+XrdHdfs::BufferPool   *m_buf_pool;
+
+// Read-only file handles kept open after close for reuse; NULL if disabled.
+int                    m_handlecache_ttl;
+int                    m_handlecache_size;
+XrdHdfs::HandleCache  *m_handle_cache;
+
+// If true, opens for reading defer hdfsOpenFile to the first Read.
+bool                   m_lazy_open;
+
+// HDFS client library: libhdfs, or a native (JVM-free) one; an empty
+// m_backend_lib means the default library for the kind.
+bool                   m_backend_native;
+std::string            m_backend_lib;
+
+// Per-operation latency histograms, and how often to log their summary
+// (0 for never).
+bool                   m_latency_enabled;
+int                    m_statslog_interval;
+
+// Log operations taking at least this many milliseconds; 0 if off.
+int                    m_slowlog_threshold;
+
+// I/O accounting by user and path prefix: the most users tracked apart, and
+// how many of the busiest getStats reports.
+bool                   m_ioaccount;
+int                    m_ioaccount_maxusers;
+int                    m_ioaccount_top;
+std::vector<std::string> m_io_prefixes;
+
+// Most trace messages logged a second (0 for no limit); the events traced
+// are in OssTrace.What.
+int                    m_trace_rate;
+
+// Warm-up in the background after Init: the users to open connections for
+// and a file to read, besides the cmsd's.  The data server writes
+// m_warm_marker when done; until the cmsd sees it, or for at most
+// m_warmup_hold seconds after Init, the cmsd's existence probes wait, so the
+// server is not advertised to clients before it is ready.
+bool                   m_warmup;
+std::vector<std::string> m_warmup_users;
+std::string            m_warmup_file;
+std::string            m_warm_marker;
+int                    m_warmup_hold;
+bool                   m_cmsd_fs;  // This plugin is the cmsd's, not the data server's.
+std::atomic<bool>      m_warm;
+std::atomic<long long> m_warm_ms;
+time_t                 m_warm_deadline;
+XrdSysCondVar          m_warm_cond;
 
 };
 #endif
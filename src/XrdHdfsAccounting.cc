@@ -0,0 +1,285 @@
+
+#include "XrdHdfsAccounting.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+using namespace XrdHdfs;
+
+
+IoAccounting *XrdHdfs::g_accounting = NULL;
+
+const char * const IoAccounting::OtherName = "(other)";
+
+
+namespace
+{
+
+// FNV-1a.
+size_t
+HashName(const char *name)
+{
+    size_t hash = 14695981039346656037ULL;
+    for (; *name; name++)
+    {
+        hash ^= static_cast<unsigned char>(*name);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// User names are DNs or whatever the security plugin maps them to; keep
+// them from breaking the XML of getStats.
+std::string
+XmlEscape(const std::string &text)
+{
+    std::string result;
+    for (std::string::const_iterator iter = text.begin(); iter != text.end(); ++iter)
+    {
+        switch (*iter)
+        {
+        case '<':  result += "&lt;"; break;
+        case '>':  result += "&gt;"; break;
+        case '&':  result += "&amp;"; break;
+        case '"':  result += "&quot;"; break;
+        default:   result += *iter;
+        }
+    }
+    return result;
+}
+
+
+bool
+ByHdfsTime(const IoAccounting::Summary &left, const IoAccounting::Summary &right)
+{
+    return left.m_hdfs_micros > right.m_hdfs_micros;
+}
+
+
+void
+AppendStats(std::string &result, const char *tag, const IoAccounting::Summary &summary)
+{
+    char counters[256];
+    snprintf(counters, sizeof(counters),
+             "</name><ops>%llu</ops><read>%llu</read><written>%llu</written><hdfsus>%llu</hdfsus></%s>",
+             summary.m_ops, summary.m_bytes_read, summary.m_bytes_written, summary.m_hdfs_micros, tag);
+    result += std::string("<") + tag + "><name>" + XmlEscape(summary.m_name) + counters;
+}
+
+
+std::string
+ReportLine(const char *kind, const IoAccounting::Summary &summary)
+{
+    char counters[256];
+    snprintf(counters, sizeof(counters), " ops=%llu read=%llu written=%llu hdfs_us=%llu",
+             summary.m_ops, summary.m_bytes_read, summary.m_bytes_written, summary.m_hdfs_micros);
+    return std::string(kind) + "=" + summary.m_name + counters;
+}
+
+}
+
+
+void
+IoAccounting::Counters::Add(unsigned long long bytes_read, unsigned long long bytes_written,
+                            unsigned long long hdfs_micros)
+{
+    m_ops.fetch_add(1, std::memory_order_relaxed);
+    if (bytes_read) {m_bytes_read.fetch_add(bytes_read, std::memory_order_relaxed);}
+    if (bytes_written) {m_bytes_written.fetch_add(bytes_written, std::memory_order_relaxed);}
+    if (hdfs_micros) {m_hdfs_micros.fetch_add(hdfs_micros, std::memory_order_relaxed);}
+}
+
+
+void
+IoAccounting::Counters::Get(const std::string &name, Summary &summary) const
+{
+    summary.m_name = name;
+    summary.m_ops = m_ops.load(std::memory_order_relaxed);
+    summary.m_bytes_read = m_bytes_read.load(std::memory_order_relaxed);
+    summary.m_bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+    summary.m_hdfs_micros = m_hdfs_micros.load(std::memory_order_relaxed);
+}
+
+
+IoAccounting::IoAccounting(const std::vector<std::string> &prefixes, unsigned max_users)
+    : m_max_users(max_users),
+      m_user_count(0)
+{
+    for (std::vector<std::string>::const_iterator iter = prefixes.begin();
+         iter != prefixes.end(); ++iter)
+    {
+        std::string prefix = *iter;
+        while ((prefix.size() > 1) && (prefix[prefix.size()-1] == '/'))
+        {
+            prefix.erase(prefix.size()-1);
+        }
+        if (std::find(m_prefixes.begin(), m_prefixes.end(), prefix) == m_prefixes.end())
+        {
+            m_prefixes.push_back(prefix);
+        }
+    }
+    m_prefix_counters = new Counters[m_prefixes.size() + 1];
+
+    // At most half full, so probes stay short.
+    size_t slots = 16;
+    while (slots < 2 * static_cast<size_t>(max_users)) {slots *= 2;}
+    m_mask = slots - 1;
+    m_users = new std::atomic<UserEntry *>[slots];
+    for (size_t idx = 0; idx < slots; idx++) {m_users[idx] = NULL;}
+}
+
+
+IoAccounting::~IoAccounting()
+{
+    for (size_t idx = 0; idx <= m_mask; idx++) {delete m_users[idx].load();}
+    delete [] m_users;
+    delete [] m_prefix_counters;
+}
+
+
+IoAccounting::Counters &
+IoAccounting::User(const char *user)
+{
+    if (!user || !user[0]) {return m_other_users;}
+
+    UserEntry *created = NULL;
+    for (size_t probe = 0, idx = HashName(user) & m_mask; probe <= m_mask; probe++, idx = (idx + 1) & m_mask)
+    {
+        UserEntry *entry = m_users[idx].load(std::memory_order_acquire);
+        if (!entry)
+        {
+            if (!created)
+            {
+                if (m_user_count.fetch_add(1, std::memory_order_relaxed) >= m_max_users)
+                {
+                    m_user_count.fetch_sub(1, std::memory_order_relaxed);
+                    return m_other_users;
+                }
+                created = new UserEntry();
+                created->m_name = user;
+            }
+            if (m_users[idx].compare_exchange_strong(entry, created, std::memory_order_acq_rel))
+            {
+                return created->m_counters;
+            }
+            // Lost the slot; `entry` is now whoever won it.
+        }
+        if (entry->m_name == user)
+        {
+            if (created)
+            {
+                delete created;
+                m_user_count.fetch_sub(1, std::memory_order_relaxed);
+            }
+            return entry->m_counters;
+        }
+    }
+    // Unreachable while the table is at most half full.
+    if (created)
+    {
+        delete created;
+        m_user_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return m_other_users;
+}
+
+
+IoAccounting::Counters &
+IoAccounting::Prefix(const char *path)
+{
+    size_t best = m_prefixes.size(), best_len = 0;
+    for (size_t idx = 0; path && (idx < m_prefixes.size()); idx++)
+    {
+        const std::string &prefix = m_prefixes[idx];
+        size_t len = prefix.size();
+        if ((len <= best_len) || strncmp(path, prefix.c_str(), len)) {continue;}
+        // "/store" covers "/store" and "/store/x", but not "/storex".
+        if ((path[len] != '\0') && (path[len] != '/') && (prefix != "/")) {continue;}
+        best = idx;
+        best_len = len;
+    }
+    return m_prefix_counters[best];
+}
+
+
+void
+IoAccounting::Record(const char *user, const char *path, unsigned long long bytes_read,
+                     unsigned long long bytes_written, unsigned long long hdfs_micros)
+{
+    User(user).Add(bytes_read, bytes_written, hdfs_micros);
+    Prefix(path).Add(bytes_read, bytes_written, hdfs_micros);
+}
+
+
+void
+IoAccounting::Users(std::vector<Summary> &result) const
+{
+    Summary summary;
+    for (size_t idx = 0; idx <= m_mask; idx++)
+    {
+        const UserEntry *entry = m_users[idx].load(std::memory_order_acquire);
+        if (!entry) {continue;}
+        entry->m_counters.Get(entry->m_name, summary);
+        result.push_back(summary);
+    }
+    m_other_users.Get(OtherName, summary);
+    if (summary.m_ops) {result.push_back(summary);}
+}
+
+
+void
+IoAccounting::Prefixes(std::vector<Summary> &result) const
+{
+    Summary summary;
+    for (size_t idx = 0; idx < m_prefixes.size(); idx++)
+    {
+        m_prefix_counters[idx].Get(m_prefixes[idx], summary);
+        result.push_back(summary);
+    }
+    m_prefix_counters[m_prefixes.size()].Get(OtherName, summary);
+    if (summary.m_ops) {result.push_back(summary);}
+}
+
+
+std::string
+IoAccounting::Stats(unsigned top) const
+{
+    std::vector<Summary> users;
+    Users(users);
+    if (users.size() > top)
+    {
+        std::partial_sort(users.begin(), users.begin() + top, users.end(), ByHdfsTime);
+        users.resize(top);
+    }
+    else
+    {
+        std::sort(users.begin(), users.end(), ByHdfsTime);
+    }
+
+    std::vector<Summary> prefixes;
+    Prefixes(prefixes);
+
+    std::string result = "<iouser>";
+    for (size_t idx = 0; idx < users.size(); idx++) {AppendStats(result, "user", users[idx]);}
+    result += "</iouser><ioprefix>";
+    for (size_t idx = 0; idx < prefixes.size(); idx++) {AppendStats(result, "prefix", prefixes[idx]);}
+    result += "</ioprefix>";
+    return result;
+}
+
+
+void
+IoAccounting::Report(std::vector<std::string> &lines) const
+{
+    std::vector<Summary> users;
+    Users(users);
+    std::sort(users.begin(), users.end(), ByHdfsTime);
+    for (size_t idx = 0; idx < users.size(); idx++) {lines.push_back(ReportLine("user", users[idx]));}
+
+    std::vector<Summary> prefixes;
+    Prefixes(prefixes);
+    for (size_t idx = 0; idx < prefixes.size(); idx++) {lines.push_back(ReportLine("prefix", prefixes[idx]));}
+}
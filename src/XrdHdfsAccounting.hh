@@ -0,0 +1,101 @@
+
+/*
+ * Accounting of the I/O done by the Xrootd HDFS plugin, by user and by path
+ * prefix.
+ */
+
+#ifndef __XRDHDFS_ACCOUNTING_H__
+#define __XRDHDFS_ACCOUNTING_H__
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace XrdHdfs {
+
+/*
+ * Counts the operations, bytes read and written, and time spent in HDFS of
+ * every plugin operation, by the user it was made for and by the configured
+ * path prefix it falls under.
+ *
+ * Recording takes no locks: users live in a fixed-size open-addressing table
+ * which is only ever inserted into, and every counter is a relaxed atomic.
+ * Users beyond the limit, and paths under no prefix, are counted together
+ * under OtherName.  A path belongs to the longest prefix matching it on a
+ * path component boundary, as with oss.namespace.
+ */
+class IoAccounting
+{
+public:
+    static const char * const OtherName;
+
+    struct Summary
+    {
+        std::string m_name;
+        unsigned long long m_ops;
+        unsigned long long m_bytes_read;
+        unsigned long long m_bytes_written;
+        unsigned long long m_hdfs_micros;
+    };
+
+    IoAccounting(const std::vector<std::string> &prefixes, unsigned max_users);
+    ~IoAccounting();
+
+    // Account one operation made for `user` on `path`.
+    void Record(const char *user, const char *path, unsigned long long bytes_read,
+                unsigned long long bytes_written, unsigned long long hdfs_micros);
+
+    // Totals so far of each user and each prefix, the others last.
+    void Users(std::vector<Summary> &result) const;
+    void Prefixes(std::vector<Summary> &result) const;
+
+    // For getStats: the `top` users with the most time in HDFS, and every
+    // prefix, as <iouser>...</iouser><ioprefix>...</ioprefix>.
+    std::string Stats(unsigned top) const;
+
+    // One line per user and per prefix, for the log.
+    void Report(std::vector<std::string> &lines) const;
+
+private:
+    IoAccounting(IoAccounting const &);
+    IoAccounting & operator=(IoAccounting const &);
+
+    struct Counters
+    {
+        Counters() : m_ops(0), m_bytes_read(0), m_bytes_written(0), m_hdfs_micros(0) {}
+
+        void Add(unsigned long long bytes_read, unsigned long long bytes_written,
+                 unsigned long long hdfs_micros);
+        void Get(const std::string &name, Summary &summary) const;
+
+        std::atomic<unsigned long long> m_ops;
+        std::atomic<unsigned long long> m_bytes_read;
+        std::atomic<unsigned long long> m_bytes_written;
+        std::atomic<unsigned long long> m_hdfs_micros;
+    };
+
+    struct UserEntry
+    {
+        std::string m_name;
+        Counters m_counters;
+    };
+
+    Counters &User(const char *user);
+    Counters &Prefix(const char *path);
+
+    std::vector<std::string> m_prefixes;
+    Counters *m_prefix_counters; // One per prefix, then the others.
+
+    unsigned m_max_users;
+    size_t m_mask;
+    std::atomic<UserEntry *> *m_users;
+    std::atomic<unsigned> m_user_count;
+    Counters m_other_users;
+};
+
+// The plugin's accounting; NULL unless enabled.
+extern IoAccounting *g_accounting;
+
+}
+
+#endif
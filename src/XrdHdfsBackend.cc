@@ -0,0 +1,89 @@
+
+#include "XrdHdfsBackend.hh"
+
+#include <errno.h>
+#include <dlfcn.h>
+
+using namespace XrdHdfs;
+
+// The default libhdfs, by soname, so dlopen finds whichever version is
+// installed on the library path; packagers may override it at build time.
+#ifndef XRDHDFS_LIBHDFS
+#define XRDHDFS_LIBHDFS "libhdfs.so.0"
+#endif
+
+
+Backend XrdHdfs::g_backend;
+
+
+namespace
+{
+
+// Resolve `name` from `handle` into `fn`; returns false if it is missing.
+template <typename Fn>
+bool
+Resolve(void *handle, const char *name, Fn &fn, std::string &detail)
+{
+    fn = reinterpret_cast<Fn>(dlsym(handle, name));
+    if (!fn) {detail = name;}
+    return fn;
+}
+
+}
+
+
+const char *
+XrdHdfs::DefaultBackendLibrary(Backend::Kind kind)
+{
+    return (kind == Backend::Native) ? "libhdfs3.so" : XRDHDFS_LIBHDFS;
+}
+
+
+const char *
+XrdHdfs::FallbackBackendLibrary(Backend::Kind kind)
+{
+    // Some Hadoop builds install libhdfs without a versioned soname.
+    return (kind == Backend::Native) ? NULL : "libhdfs.so";
+}
+
+
+int
+XrdHdfs::LoadBackend(Backend::Kind kind, const std::string &library, std::string &detail)
+{
+    // RTLD_GLOBAL as libhdfs looks up the JVM's symbols (and the JVM its own)
+    // in the global namespace.
+    void *handle = dlopen(library.c_str(), RTLD_NOW|RTLD_GLOBAL);
+    if (!handle)
+    {
+        const char *err = dlerror();
+        detail = err ? err : library;
+        return ENOENT;
+    }
+
+    Backend backend;
+    backend.m_kind = kind;
+    backend.m_library = library;
+    if (!Resolve(handle, "hdfsConnectAsUserNewInstance", backend.ConnectAsUserNewInstance, detail) ||
+        !Resolve(handle, "hdfsDisconnect", backend.Disconnect, detail) ||
+        !Resolve(handle, "hdfsGetPathInfo", backend.GetPathInfo, detail) ||
+        !Resolve(handle, "hdfsListDirectory", backend.ListDirectory, detail) ||
+        !Resolve(handle, "hdfsFreeFileInfo", backend.FreeFileInfo, detail) ||
+        !Resolve(handle, "hdfsExists", backend.Exists, detail) ||
+        !Resolve(handle, "hdfsCreateDirectory", backend.CreateDirectory, detail) ||
+        !Resolve(handle, "hdfsChmod", backend.Chmod, detail) ||
+        !Resolve(handle, "hdfsDelete", backend.Delete, detail) ||
+        !Resolve(handle, "hdfsRename", backend.Rename, detail) ||
+        !Resolve(handle, "hdfsOpenFile", backend.OpenFile, detail) ||
+        !Resolve(handle, "hdfsCloseFile", backend.CloseFile, detail) ||
+        !Resolve(handle, "hdfsAvailable", backend.Available, detail) ||
+        !Resolve(handle, "hdfsPread", backend.Pread, detail) ||
+        !Resolve(handle, "hdfsWrite", backend.Write, detail))
+    {
+        detail = library + " has no " + detail;
+        dlclose(handle);
+        return ENOSYS;
+    }
+
+    g_backend = backend;
+    return 0;
+}
@@ -0,0 +1,67 @@
+
+/*
+ * The HDFS client library used by the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_BACKEND_H__
+#define __XRDHDFS_BACKEND_H__
+
+#include <string>
+
+#include "hdfs.h"
+
+namespace XrdHdfs {
+
+/*
+ * The plugin only uses the C API declared in hdfs.h.  Hadoop's libhdfs
+ * implements it on top of an embedded JVM; native clients such as libhdfs3
+ * implement the same API (and ABI) by speaking the HDFS protocols directly,
+ * with no JVM, heap or JNI copies.
+ *
+ * Rather than being linked against libhdfs, the plugin loads the configured
+ * client library at startup and calls it through this table.  Only the
+ * wrappers in XrdHdfsCalls.cc should use it.
+ */
+struct Backend
+{
+    enum Kind
+    {
+        Libhdfs, // Hadoop's JNI-based libhdfs.
+        Native   // A JVM-free implementation of hdfs.h.
+    };
+
+    Kind m_kind;
+    std::string m_library;
+
+    hdfsFS (*ConnectAsUserNewInstance)(const char *nn, tPort port, const char *user);
+    int (*Disconnect)(hdfsFS fs);
+    hdfsFileInfo *(*GetPathInfo)(hdfsFS fs, const char *path);
+    hdfsFileInfo *(*ListDirectory)(hdfsFS fs, const char *path, int *numEntries);
+    void (*FreeFileInfo)(hdfsFileInfo *info, int numEntries);
+    int (*Exists)(hdfsFS fs, const char *path);
+    int (*CreateDirectory)(hdfsFS fs, const char *path);
+    int (*Chmod)(hdfsFS fs, const char *path, short mode);
+    int (*Delete)(hdfsFS fs, const char *path, int recursive);
+    int (*Rename)(hdfsFS fs, const char *oldPath, const char *newPath);
+    hdfsFile (*OpenFile)(hdfsFS fs, const char *path, int flags, int bufferSize,
+                         short replication, tSize blocksize);
+    int (*CloseFile)(hdfsFS fs, hdfsFile file);
+    int (*Available)(hdfsFS fs, hdfsFile file);
+    tSize (*Pread)(hdfsFS fs, hdfsFile file, tOffset position, void *buffer, tSize length);
+    tSize (*Write)(hdfsFS fs, hdfsFile file, const void *buffer, tSize length);
+};
+
+// The default client library for each kind of backend, and the library to
+// try if that is not installed (NULL if none).
+const char *DefaultBackendLibrary(Backend::Kind kind);
+const char *FallbackBackendLibrary(Backend::Kind kind);
+
+// Load `library` and resolve its hdfs.h functions into g_backend.  Returns 0
+// or an errno value, with `detail` describing the failure.
+int LoadBackend(Backend::Kind kind, const std::string &library, std::string &detail);
+
+extern Backend g_backend;
+
+}
+
+#endif
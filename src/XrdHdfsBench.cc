@@ -0,0 +1,421 @@
+
+/*
+ * Micro-benchmark for the Xrootd HDFS plugin's file I/O.
+ *
+ * Loads libXrdHdfsReal in-process, by default on top of the mock libhdfs
+ * (see XrdHdfsMock.cc; its XRDHDFS_MOCK_* settings apply), and drives
+ * XrdHdfsFile with a set of access patterns at several concurrency levels.
+ * Each thread opens its own file object, as separate xrootd clients would.
+ *
+ * Prints one JSON object per (pattern, threads) run on stdout:
+ *
+ *     {"pattern":"random","threads":4,"ops":...,"bytes":...,"seconds":...,
+ *      "mb_per_s":...,"ops_per_s":...,"p50_us":...,"p90_us":...,
+ *      "p99_us":...,"max_us":...,"readbuf_hits":...,"readbuf_partial":...,
+ *      "readbuf_misses":...,"readbuf_bypassed":...}
+ *
+ * The plugin's own log goes to stderr.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "XrdOss/XrdOss.hh"
+#include "XrdOuc/XrdOucEnv.hh"
+#include "XrdOuc/XrdOucIOVec.hh"
+
+#include "XrdHdfsHarness.hh"
+
+namespace
+{
+
+enum Pattern
+{
+    Sequential, // 1 MiB reads from start to end.
+    SmallBlock, // 4 KiB reads from start to end.
+    Strided,    // 4 KiB reads every 64 KiB.
+    Random,     // 64 KiB reads at random offsets.
+    ReadV,      // Vectors of 16 random 4 KiB reads.
+    WriteSeq    // 1 MiB sequential writes to a new file.
+};
+
+struct PatternInfo
+{
+    const char *m_name;
+    Pattern m_pattern;
+    size_t m_block;
+};
+
+const PatternInfo g_patterns[] =
+{
+    {"sequential", Sequential, 1024*1024},
+    {"smallblock", SmallBlock, 4*1024},
+    {"strided",    Strided,    4*1024},
+    {"random",     Random,     64*1024},
+    {"readv",      ReadV,      4*1024},
+    {"write",      WriteSeq,   1024*1024}
+};
+
+const int g_readv_count = 16;
+const off_t g_stride = 64*1024;
+
+struct Worker
+{
+    XrdOss *m_oss;
+    const PatternInfo *m_info;
+    std::string m_path;
+    off_t m_file_size;
+    double m_deadline;
+    unsigned m_seed;
+
+    unsigned long long m_ops;
+    unsigned long long m_bytes;
+    int m_error;
+    std::vector<float> m_latencies_us;
+};
+
+
+double
+Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+off_t
+RandomOffset(unsigned &seed, off_t file_size, size_t block)
+{
+    off_t blocks = file_size / block;
+    if (blocks <= 1) {return 0;}
+    off_t pick = (static_cast<off_t>(rand_r(&seed)) << 16) ^ rand_r(&seed);
+    return (pick % blocks) * block;
+}
+
+
+void *
+RunWorker(void *arg)
+{
+    Worker &worker = *static_cast<Worker *>(arg);
+    const PatternInfo &info = *worker.m_info;
+    bool writing = info.m_pattern == WriteSeq;
+
+    XrdOucEnv env;
+    XrdOssDF *fp = worker.m_oss->newFile("bench");
+    int rc = writing ? fp->Open(worker.m_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644, env)
+                     : fp->Open(worker.m_path.c_str(), O_RDONLY, 0, env);
+    if (rc)
+    {
+        worker.m_error = -rc;
+        delete fp;
+        return NULL;
+    }
+
+    size_t buffer_size = (info.m_pattern == ReadV) ? info.m_block * g_readv_count : info.m_block;
+    std::vector<char> buffer(buffer_size, 'x');
+    XrdOucIOVec iov[g_readv_count];
+    off_t offset = 0;
+
+    while (Now() < worker.m_deadline)
+    {
+        ssize_t expected = info.m_block;
+        switch (info.m_pattern)
+        {
+        case Sequential:
+        case SmallBlock:
+        case Strided:
+            if (offset + static_cast<off_t>(info.m_block) > worker.m_file_size) {offset = 0;}
+            break;
+        case Random:
+            offset = RandomOffset(worker.m_seed, worker.m_file_size, info.m_block);
+            break;
+        case ReadV:
+            for (int idx = 0; idx < g_readv_count; idx++)
+            {
+                iov[idx].offset = RandomOffset(worker.m_seed, worker.m_file_size, info.m_block);
+                iov[idx].size = info.m_block;
+                iov[idx].info = 0;
+                iov[idx].data = &buffer[idx * info.m_block];
+            }
+            expected = info.m_block * g_readv_count;
+            break;
+        case WriteSeq:
+            // HDFS files are written sequentially; start over once full.
+            if (offset + static_cast<off_t>(info.m_block) > worker.m_file_size)
+            {
+                fp->Close();
+                if ((rc = fp->Open(worker.m_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644, env)))
+                {
+                    worker.m_error = -rc;
+                    delete fp;
+                    return NULL;
+                }
+                offset = 0;
+            }
+            break;
+        }
+
+        double start = Now();
+        ssize_t result;
+        if (info.m_pattern == ReadV) {result = fp->ReadV(iov, g_readv_count);}
+        else if (writing) {result = fp->Write(&buffer[0], offset, info.m_block);}
+        else {result = fp->Read(&buffer[0], offset, info.m_block);}
+        worker.m_latencies_us.push_back((Now() - start) * 1e6);
+
+        if (result != expected)
+        {
+            worker.m_error = (result < 0) ? -result : EIO;
+            break;
+        }
+        worker.m_ops++;
+        worker.m_bytes += result;
+        offset += (info.m_pattern == Strided) ? g_stride : static_cast<off_t>(info.m_block);
+    }
+
+    fp->Close();
+    delete fp;
+    return NULL;
+}
+
+
+// Create the file the read patterns use, through the plugin.
+int
+CreateInput(XrdOss *oss, const std::string &path, off_t size)
+{
+    XrdOucEnv env;
+    XrdOssDF *fp = oss->newFile("bench");
+    int rc = fp->Open(path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644, env);
+    if (rc) {delete fp; return -rc;}
+
+    std::vector<char> buffer(1024*1024);
+    unsigned seed = 1;
+    for (off_t offset = 0; offset < size; offset += buffer.size())
+    {
+        for (size_t idx = 0; idx < buffer.size(); idx++) {buffer[idx] = rand_r(&seed);}
+        size_t len = std::min(static_cast<off_t>(buffer.size()), size - offset);
+        ssize_t result = fp->Write(&buffer[0], offset, len);
+        if (result != static_cast<ssize_t>(len))
+        {
+            fp->Close();
+            delete fp;
+            return (result < 0) ? -result : EIO;
+        }
+    }
+    rc = fp->Close();
+    delete fp;
+    return -rc;
+}
+
+
+float
+Percentile(const std::vector<float> &sorted, double fraction)
+{
+    if (sorted.empty()) {return 0;}
+    size_t idx = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[idx];
+}
+
+
+int
+Run(XrdHdfs::Harness &harness, XrdOss *oss, const PatternInfo &info, int threads,
+    const std::string &dir, off_t file_size, double duration)
+{
+    unsigned long long hits = harness.Stat("readbuf", "hits");
+    unsigned long long partial = harness.Stat("readbuf", "partial");
+    unsigned long long misses = harness.Stat("readbuf", "misses");
+    unsigned long long bypassed = harness.Stat("readbuf", "bypassed");
+
+    std::vector<Worker> workers(threads);
+    std::vector<pthread_t> tids(threads);
+    double start = Now();
+    for (int idx = 0; idx < threads; idx++)
+    {
+        Worker &worker = workers[idx];
+        worker.m_oss = oss;
+        worker.m_info = &info;
+        worker.m_path = (info.m_pattern == WriteSeq) ? dir + "/write." + std::to_string(idx) : dir + "/input";
+        worker.m_file_size = file_size;
+        worker.m_deadline = start + duration;
+        worker.m_seed = idx + 1;
+        worker.m_ops = worker.m_bytes = 0;
+        worker.m_error = 0;
+        if (pthread_create(&tids[idx], NULL, RunWorker, &worker))
+        {
+            fprintf(stderr, "Failed to start a benchmark thread\n");
+            exit(1);
+        }
+    }
+
+    unsigned long long ops = 0, bytes = 0;
+    std::vector<float> latencies;
+    int error = 0;
+    for (int idx = 0; idx < threads; idx++)
+    {
+        pthread_join(tids[idx], NULL);
+        ops += workers[idx].m_ops;
+        bytes += workers[idx].m_bytes;
+        latencies.insert(latencies.end(), workers[idx].m_latencies_us.begin(), workers[idx].m_latencies_us.end());
+        if (workers[idx].m_error) {error = workers[idx].m_error;}
+    }
+    double seconds = Now() - start;
+    if (info.m_pattern == WriteSeq)
+    {
+        for (int idx = 0; idx < threads; idx++) {oss->Unlink(workers[idx].m_path.c_str());}
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    if (error)
+    {
+        fprintf(stderr, "%s with %d threads failed: %s\n", info.m_name, threads, strerror(error));
+        return error;
+    }
+
+    printf("{\"pattern\":\"%s\",\"threads\":%d,\"ops\":%llu,\"bytes\":%llu,\"seconds\":%.3f,"
+           "\"mb_per_s\":%.2f,\"ops_per_s\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,"
+           "\"readbuf_hits\":%llu,\"readbuf_partial\":%llu,\"readbuf_misses\":%llu,\"readbuf_bypassed\":%llu}\n",
+           info.m_name, threads, ops, bytes, seconds,
+           bytes / seconds / (1024*1024), ops / seconds,
+           Percentile(latencies, 0.5), Percentile(latencies, 0.9), Percentile(latencies, 0.99),
+           latencies.empty() ? 0.0f : latencies.back(),
+           harness.Stat("readbuf", "hits") - hits, harness.Stat("readbuf", "partial") - partial,
+           harness.Stat("readbuf", "misses") - misses, harness.Stat("readbuf", "bypassed") - bypassed);
+    fflush(stdout);
+    return 0;
+}
+
+
+void
+Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-c config] [-l plugin] [-m mock] [-D directive] [-p dir]\n"
+        "          [-s size_mb] [-t threads,...] [-d seconds] [pattern ...]\n"
+        "\n"
+        "  -c  xrootd configuration to initialize the plugin with; by default\n"
+        "      the mock libhdfs is used, over a temporary directory.\n"
+        "  -l  libXrdHdfsReal to load (default: next to this program).\n"
+        "  -m  libXrdHdfsMock to use (default: next to this program).\n"
+        "  -D  extra directive for the generated configuration; repeatable.\n"
+        "  -p  directory, in the plugin's namespace, for the test files (/bench).\n"
+        "  -s  size of the file read, in MiB (256).\n"
+        "  -t  comma-separated thread counts (1,4,16).\n"
+        "  -d  seconds per run (5).\n"
+        "\n"
+        "Patterns: sequential smallblock strided random readv write (default all).\n",
+        prog);
+}
+
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    XrdHdfs::Harness harness;
+    std::string dir = "/bench";
+    off_t file_size = 256LL*1024*1024;
+    std::vector<int> thread_counts;
+    double duration = 5;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:l:m:D:p:s:t:d:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': harness.m_config = optarg; break;
+        case 'l': harness.m_plugin = optarg; break;
+        case 'm': harness.m_mock = optarg; break;
+        case 'D': harness.m_directives += std::string(optarg) + "\n"; break;
+        case 'p': dir = optarg; break;
+        case 's': file_size = strtoll(optarg, NULL, 10) * 1024 * 1024; break;
+        case 'd': duration = strtod(optarg, NULL); break;
+        case 't':
+            for (char *tok = strtok(optarg, ","); tok; tok = strtok(NULL, ","))
+            {
+                thread_counts.push_back(atoi(tok));
+            }
+            break;
+        default:
+            Usage(argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if (thread_counts.empty())
+    {
+        thread_counts.push_back(1);
+        thread_counts.push_back(4);
+        thread_counts.push_back(16);
+    }
+    for (size_t idx = 0; idx < thread_counts.size(); idx++)
+    {
+        if (thread_counts[idx] <= 0) {Usage(argv[0]); return 2;}
+    }
+    if ((file_size <= 0) || (duration <= 0)) {Usage(argv[0]); return 2;}
+
+    std::vector<const PatternInfo *> patterns;
+    for (int idx = optind; idx < argc; idx++)
+    {
+        const PatternInfo *found = NULL;
+        for (size_t pidx = 0; pidx < sizeof(g_patterns)/sizeof(g_patterns[0]); pidx++)
+        {
+            if (!strcmp(argv[idx], g_patterns[pidx].m_name)) {found = &g_patterns[pidx];}
+        }
+        if (!found)
+        {
+            fprintf(stderr, "Unknown pattern %s\n", argv[idx]);
+            Usage(argv[0]);
+            return 2;
+        }
+        patterns.push_back(found);
+    }
+    if (patterns.empty())
+    {
+        for (size_t pidx = 0; pidx < sizeof(g_patterns)/sizeof(g_patterns[0]); pidx++)
+        {
+            patterns.push_back(&g_patterns[pidx]);
+        }
+    }
+
+    std::string error;
+    XrdOss *oss = harness.Load(error);
+    if (!oss)
+    {
+        fprintf(stderr, "Failed to load the plugin: %s\n", error.c_str());
+        return 1;
+    }
+
+    int rc = oss->Mkdir(dir.c_str(), 0755, 1);
+    if (rc && (rc != -EEXIST))
+    {
+        fprintf(stderr, "Failed to create %s: %s\n", dir.c_str(), strerror(-rc));
+        return 1;
+    }
+    if ((rc = CreateInput(oss, dir + "/input", file_size)))
+    {
+        fprintf(stderr, "Failed to create %s/input: %s\n", dir.c_str(), strerror(rc));
+        return 1;
+    }
+
+    int failures = 0;
+    for (size_t pidx = 0; pidx < patterns.size(); pidx++)
+    {
+        for (size_t tidx = 0; tidx < thread_counts.size(); tidx++)
+        {
+            if (Run(harness, oss, *patterns[pidx], thread_counts[tidx], dir, file_size, duration)) {failures++;}
+        }
+    }
+
+    oss->Unlink((dir + "/input").c_str());
+    return failures ? 1 : 0;
+}
@@ -7,7 +7,16 @@
 #include <string.h>
 #include <errno.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
+#include <string>
+#include <vector>
+
+#include "XrdOuc/XrdOucEnv.hh"
+#include "XrdOuc/XrdOucStream.hh"
 #include "XrdSys/XrdSysPlugin.hh"
 #include "XrdSys/XrdSysError.hh"
 #include "XrdVersion.hh"
@@ -23,6 +32,7 @@ class XrdSysLogger;
 
 static XrdOss *Bootstrap(XrdOss*, XrdSysLogger *, const char *, const char *);
 static int DetermineEnvironment();
+static bool NativeBackend(const char *);
 
 XrdOss *g_hdfs_oss = NULL;
 
@@ -69,7 +79,11 @@ static int loadJvm() {
 }
 
 static XrdOss *Bootstrap(XrdOss *native_oss,XrdSysLogger *Logger, const char *config_fn, const char *parms) {
-   if (DetermineEnvironment()) {
+   HdfsBootstrapEroute.logger(Logger);
+
+   // A native client library needs neither the Hadoop environment nor a JVM.
+   bool native = NativeBackend(config_fn);
+   if (!native && DetermineEnvironment()) {
       return 0;
    }
 
@@ -79,9 +93,8 @@ static XrdOss *Bootstrap(XrdOss *native_oss,XrdSysLogger *Logger, const char *co
 
    // Load the JVM from the environment we just computed.
    // The dynamic linker only pays attention to the LD_LIBRARY_PATH the process was started with.
-   loadJvm();
+   if (!native) loadJvm();
  
-   HdfsBootstrapEroute.logger(Logger);
    myLib = new XrdSysPlugin(&HdfsBootstrapEroute, "libXrdHdfsReal-" XRDPLUGIN_SOVERSION ".so");
    if (!myLib) return 0;
 
@@ -96,6 +109,27 @@ static XrdOss *Bootstrap(XrdOss *native_oss,XrdSysLogger *Logger, const char *co
    return ep(native_oss, Logger, config_fn, parms);
 }
 
+// Returns true if the configuration selects a native (JVM-free) backend with
+// "oss.backend native"; the real module parses the directive fully.
+static bool NativeBackend(const char *config_fn) {
+   if (!config_fn || !*config_fn) return false;
+   int fd = open(config_fn, O_RDONLY, 0);
+   if (fd < 0) return false;
+
+   XrdOucEnv myEnv;
+   XrdOucStream Config(&HdfsBootstrapEroute, getenv("XRDINSTANCE"), &myEnv, "=====> ");
+   Config.Attach(fd);
+   bool native = false;
+   char *var;
+   while ((var = Config.GetMyFirstWord())) {
+      if (!strcmp(var, "oss.backend") && (var = Config.GetWord())) {
+         native = !strcmp(var, "native");
+      }
+   }
+   Config.Close();
+   return native;
+}
+
 static int CheckEnvVar(const char * var, const char * input) {
    const char * equal_sign = strchr(input, '=');
    if (equal_sign && (strncmp(input, var, equal_sign-input) == 0)) {
@@ -105,9 +139,12 @@ static int CheckEnvVar(const char * var, const char * input) {
    return 0;
 }
 
+static const char * sysconfig_file = "/etc/sysconfig/xrootd-hdfs";
 static const char * command_string = "source /etc/sysconfig/xrootd-hdfs && /usr/libexec/xrootd-hdfs/xrootd_hdfs_envcheck";
 
-static int DetermineEnvironment( ) {
+// Run the environment script and take CLASSPATH, LIBHDFS_OPTS and
+// LD_LIBRARY_PATH from its output.
+static int EnvironmentFromShell( ) {
 
    FILE* fp =  popen(command_string, "r");
    char environ_buffer[BUFSIZE];
@@ -152,3 +189,172 @@ static int DetermineEnvironment( ) {
    return 0;
 }
 
+/*
+ * Sourcing the sysconfig file runs `hadoop classpath` and searches JAVA_HOME,
+ * which takes seconds.  Its result is cached in a file, and reused as long as
+ *  - the variables the script reads from our environment are unchanged, and
+ *  - the sysconfig file, every classpath entry (the directory, for wildcard
+ *    entries) and every LD_LIBRARY_PATH directory have the same mtimes,
+ * so installing or removing Hadoop jars or a JVM, or editing the sysconfig,
+ * invalidates it.  XRDHDFS_ENV_CACHE names the file; set it empty to always
+ * run the script.  The file is only trusted if it belongs to us and is not
+ * writable by anyone else.
+ *
+ * The cache is text, one record per line:
+ *     xrootd-hdfs-environment 1
+ *     input <NAME>[=<value>]         (no '=' if NAME was unset)
+ *     mtime <sec> <nsec> <path>      (-1 0 if path did not exist)
+ *     set <NAME>=<value>
+ */
+
+static const char * default_env_cache = "/var/cache/xrootd-hdfs/environment";
+static const char * env_cache_header = "xrootd-hdfs-environment 1";
+
+// What the environment script sets, and what of ours it depends on.
+static const char * const output_vars[] = {"CLASSPATH", "LIBHDFS_OPTS", "LD_LIBRARY_PATH"};
+static const char * const input_vars[] = {"CLASSPATH", "LIBHDFS_OPTS", "LD_LIBRARY_PATH",
+                                          "JAVA_HOME", "HADOOP_HOME", "HADOOP_CONF_DIR"};
+
+static std::string EnvCacheInput(const char *var) {
+   const char *value = getenv(var);
+   return value ? std::string(var) + "=" + value : std::string(var);
+}
+
+static std::string EnvCacheMtime(const std::string &path) {
+   struct stat st;
+   char buf[64];
+   if (stat(path.c_str(), &st)) {
+      snprintf(buf, sizeof(buf), "-1 0 ");
+   } else {
+      snprintf(buf, sizeof(buf), "%lld %ld ", (long long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+   }
+   return buf + path;
+}
+
+// The files and directories the current environment was computed from.
+static void EnvCacheDependencies(std::vector<std::string> &paths) {
+   paths.push_back(sysconfig_file);
+   const char * lists[] = {getenv("CLASSPATH"), getenv("LD_LIBRARY_PATH")};
+   for (size_t idx = 0; idx < sizeof(lists)/sizeof(lists[0]); idx++) {
+      if (!lists[idx]) continue;
+      std::string list = lists[idx];
+      size_t start = 0;
+      while (start <= list.size()) {
+         size_t end = list.find(':', start);
+         if (end == std::string::npos) end = list.size();
+         std::string entry = list.substr(start, end - start);
+         start = end + 1;
+         if (entry.size() && entry[entry.size()-1] == '*') entry.erase(entry.size()-1);
+         if (entry.empty()) continue;
+         bool seen = false;
+         for (size_t pidx = 0; pidx < paths.size() && !seen; pidx++) seen = (paths[pidx] == entry);
+         if (!seen) paths.push_back(entry);
+      }
+   }
+}
+
+// Set the environment from the cache; returns 0 if it was valid.
+static int EnvFromCache(const std::string &cache_fn, const std::vector<std::string> &inputs) {
+   FILE *fp = fopen(cache_fn.c_str(), "r");
+   if (!fp) return 1;
+
+   struct stat st;
+   if (fstat(fileno(fp), &st) || (st.st_uid != geteuid()) || (st.st_mode & (S_IWGRP|S_IWOTH))) {
+      HdfsBootstrapEroute.Say("Ignoring environment cache not private to this user: ", cache_fn.c_str());
+      fclose(fp);
+      return 1;
+   }
+
+   std::vector<std::string> settings;
+   size_t inputs_seen = 0;
+   bool valid = true, header = false;
+   char *line = NULL;
+   size_t line_size = 0;
+   ssize_t len;
+   while (valid && ((len = getline(&line, &line_size, fp)) >= 0)) {
+      std::string record(line, len);
+      if (record.size() && record[record.size()-1] == '\n') record.erase(record.size()-1);
+      if (!header) {
+         valid = header = (record == env_cache_header);
+      } else if (!record.compare(0, 6, "input ")) {
+         valid = (inputs_seen < inputs.size()) && (record.substr(6) == inputs[inputs_seen++]);
+      } else if (!record.compare(0, 6, "mtime ")) {
+         size_t path_pos = record.find(' ', record.find(' ', 6) + 1);
+         valid = (path_pos != std::string::npos) &&
+                 (record.substr(6) == EnvCacheMtime(record.substr(path_pos + 1)));
+      } else if (!record.compare(0, 4, "set ")) {
+         settings.push_back(record.substr(4));
+      } else {
+         valid = false;
+      }
+   }
+   free(line);
+   fclose(fp);
+   if (!valid || !header || (inputs_seen != inputs.size())) return 1;
+
+   for (size_t idx = 0; idx < settings.size(); idx++) {
+      size_t equal_sign = settings[idx].find('=');
+      if (equal_sign == std::string::npos) continue;
+      setenv(settings[idx].substr(0, equal_sign).c_str(), settings[idx].substr(equal_sign+1).c_str(), 1);
+   }
+   return 0;
+}
+
+// Record the environment just computed; failures only cost the next start time.
+static void EnvToCache(const std::string &cache_fn, const std::vector<std::string> &inputs) {
+   std::string contents = std::string(env_cache_header) + "\n";
+   for (size_t idx = 0; idx < inputs.size(); idx++) {
+      contents += "input " + inputs[idx] + "\n";
+   }
+   std::vector<std::string> paths;
+   EnvCacheDependencies(paths);
+   for (size_t idx = 0; idx < paths.size(); idx++) {
+      contents += "mtime " + EnvCacheMtime(paths[idx]) + "\n";
+   }
+   for (size_t idx = 0; idx < sizeof(output_vars)/sizeof(output_vars[0]); idx++) {
+      const char *value = getenv(output_vars[idx]);
+      if (!value) continue;
+      // A newline would split the record; just do without the cache.
+      if (strchr(value, '\n')) return;
+      contents += std::string("set ") + output_vars[idx] + "=" + value + "\n";
+   }
+
+   // Replace the cache atomically; xrootd and cmsd may start together.
+   std::string tmp_fn = cache_fn + ".XXXXXX";
+   std::vector<char> tmpl(tmp_fn.begin(), tmp_fn.end());
+   tmpl.push_back('\0');
+   int fd = mkstemp(&tmpl[0]);
+   if (fd < 0) return;
+   bool ok = !fchmod(fd, 0644);
+   const char *pos = contents.c_str();
+   size_t remaining = contents.size();
+   while (ok && remaining) {
+      ssize_t written = write(fd, pos, remaining);
+      if (written < 0 && errno == EINTR) continue;
+      ok = (written > 0);
+      if (ok) {pos += written; remaining -= written;}
+   }
+   ok = !close(fd) && ok;
+   if (!ok || rename(&tmpl[0], cache_fn.c_str())) {
+      unlink(&tmpl[0]);
+   }
+}
+
+static int DetermineEnvironment( ) {
+   const char *cache_env = getenv("XRDHDFS_ENV_CACHE");
+   std::string cache_fn = cache_env ? cache_env : default_env_cache;
+
+   // The script's result depends on these, so capture them before it runs.
+   std::vector<std::string> inputs;
+   for (size_t idx = 0; idx < sizeof(input_vars)/sizeof(input_vars[0]); idx++) {
+      inputs.push_back(EnvCacheInput(input_vars[idx]));
+   }
+
+   if (!cache_fn.empty() && !EnvFromCache(cache_fn, inputs)) {
+      HdfsBootstrapEroute.Say("Using the cached Hadoop environment from ", cache_fn.c_str());
+      return 0;
+   }
+   if (EnvironmentFromShell()) return 1;
+   if (!cache_fn.empty()) EnvToCache(cache_fn, inputs);
+   return 0;
+}
@@ -0,0 +1,139 @@
+
+#include "XrdHdfsBufPool.hh"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+using namespace XrdHdfs;
+
+
+BufferPool::BufferPool(size_t max_bytes, HugePages huge_pages)
+    : m_max_bytes(max_bytes),
+      m_huge_pages(huge_pages),
+      m_in_use(0),
+      m_cached(0),
+      m_allocations(0),
+      m_reuses(0),
+      m_degraded(0),
+      m_failures(0)
+{
+}
+
+
+// The smallest class holding `size` bytes.
+unsigned
+BufferPool::ClassOf(size_t size)
+{
+    unsigned cls = 0;
+    while ((cls < m_class_count - 1) && (SizeOf(cls) < size)) {cls++;}
+    return cls;
+}
+
+
+char *
+BufferPool::Allocate(size_t size)
+{
+    if (size < m_huge_size)
+    {
+        return static_cast<char *>(malloc(size));
+    }
+
+    void *buf = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (m_huge_pages == HugePagesExplicit)
+    {
+        buf = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (buf == MAP_FAILED)
+    {
+        buf = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) {return NULL;}
+#ifdef MADV_HUGEPAGE
+        if (m_huge_pages != HugePagesOff)
+        {
+            madvise(buf, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    return static_cast<char *>(buf);
+}
+
+
+void
+BufferPool::Free(char *buf, size_t size)
+{
+    if (size < m_huge_size) {free(buf);}
+    else {munmap(buf, size);}
+}
+
+
+// Release cached buffers, largest first, until `needed` more bytes fit in the
+// budget.  Called with m_mutex held.
+bool
+BufferPool::Reclaim(size_t needed)
+{
+    for (unsigned cls = m_class_count; cls-- > 0; )
+    {
+        while (!m_free[cls].empty() && (m_in_use + m_cached + needed > m_max_bytes))
+        {
+            Free(m_free[cls].back(), SizeOf(cls));
+            m_free[cls].pop_back();
+            m_cached -= SizeOf(cls);
+        }
+    }
+    return m_in_use + m_cached + needed <= m_max_bytes;
+}
+
+
+char *
+BufferPool::Acquire(size_t want, size_t &size)
+{
+    XrdSysMutexHelper lock(m_mutex);
+
+    for (unsigned cls = ClassOf(want); ; cls--)
+    {
+        size_t cls_size = SizeOf(cls);
+        if (!m_free[cls].empty())
+        {
+            char *buf = m_free[cls].back();
+            m_free[cls].pop_back();
+            m_cached -= cls_size;
+            m_in_use += cls_size;
+            m_reuses++;
+            if (cls_size < want) {m_degraded++;}
+            size = cls_size;
+            return buf;
+        }
+        if ((m_in_use + cls_size <= m_max_bytes) && Reclaim(cls_size))
+        {
+            char *buf = Allocate(cls_size);
+            if (buf)
+            {
+                m_in_use += cls_size;
+                m_allocations++;
+                if (cls_size < want) {m_degraded++;}
+                size = cls_size;
+                return buf;
+            }
+        }
+        if (!cls) {break;}
+    }
+
+    m_failures++;
+    size = 0;
+    return NULL;
+}
+
+
+void
+BufferPool::Release(char *buf, size_t size)
+{
+    if (!buf) {return;}
+
+    unsigned cls = ClassOf(size);
+    XrdSysMutexHelper lock(m_mutex);
+    m_in_use -= size;
+    m_free[cls].push_back(buf);
+    m_cached += size;
+}
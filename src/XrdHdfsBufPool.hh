@@ -0,0 +1,92 @@
+
+/*
+ * Pooled I/O buffers for the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_BUFPOOL_H__
+#define __XRDHDFS_BUFPOOL_H__
+
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace XrdHdfs {
+
+/*
+ * A pool of I/O buffers with a global memory budget.
+ *
+ * Buffers come in power-of-two size classes and are recycled between file
+ * handles rather than returned to the system on every close.  The total size
+ * of buffers in use and cached in the pool never exceeds `max_bytes`: when a
+ * request cannot be met, cached buffers are released first, and then a
+ * smaller size class is handed out instead.  If not even the smallest class
+ * fits, Acquire fails and the caller must work unbuffered.
+ *
+ * Buffers of 2MB or more are mapped directly; they can be backed by
+ * transparent huge pages (madvise) or explicitly reserved ones (MAP_HUGETLB,
+ * falling back to normal pages if none are available).
+ */
+class BufferPool
+{
+public:
+    enum HugePages
+    {
+        HugePagesOff,
+        HugePagesTransparent,
+        HugePagesExplicit
+    };
+
+    BufferPool(size_t max_bytes, HugePages huge_pages);
+
+    // Get a buffer of `want` bytes (rounded up to its size class), or a
+    // smaller one under memory pressure.  `size` is set to the size obtained.
+    // Returns NULL if no buffer can be had at all.
+    char *Acquire(size_t want, size_t &size);
+
+    // Return a buffer obtained from Acquire with the size it was given.
+    void Release(char *buf, size_t size);
+
+    size_t Budget() const {return m_max_bytes;}
+    size_t InUse() const {return m_in_use;}
+    size_t Cached() const {return m_cached;}
+    unsigned long long Allocations() const {return m_allocations;}
+    unsigned long long Reuses() const {return m_reuses;}
+    unsigned long long Degraded() const {return m_degraded;}
+    unsigned long long Failures() const {return m_failures;}
+
+    static const size_t m_min_size = 4096;
+
+private:
+    BufferPool(BufferPool const &);
+    BufferPool & operator=(BufferPool const &);
+
+    static const unsigned m_class_count = 19; // 4KB through 1GB.
+    static const size_t m_huge_size = 2*1024*1024;
+
+    static unsigned ClassOf(size_t size);
+    static size_t SizeOf(unsigned cls) {return m_min_size << cls;}
+
+    char *Allocate(size_t size);
+    void Free(char *buf, size_t size);
+    bool Reclaim(size_t needed);
+
+    const size_t m_max_bytes;
+    const HugePages m_huge_pages;
+
+    XrdSysMutex m_mutex;
+    std::vector<char *> m_free[m_class_count];
+    std::atomic<size_t> m_in_use;
+    std::atomic<size_t> m_cached;
+
+    std::atomic<unsigned long long> m_allocations;
+    std::atomic<unsigned long long> m_reuses;
+    std::atomic<unsigned long long> m_degraded;
+    std::atomic<unsigned long long> m_failures;
+};
+
+}
+
+#endif
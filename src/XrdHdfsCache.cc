@@ -0,0 +1,560 @@
+
+#include "XrdHdfsCache.hh"
+
+#include <time.h>
+
+using namespace XrdHdfs;
+
+
+long long
+XrdHdfs::MonotonicMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<long long>(ts.tv_sec)*1000 + ts.tv_nsec/1000000;
+}
+
+
+namespace
+{
+
+// FNV-1a; combined below with a second, independent mix to derive the k
+// bloom filter probes (Kirsch-Mitzenmacher double hashing).
+unsigned long long
+hash_path(const std::string &path)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (std::string::const_iterator it = path.begin(); it != path.end(); ++it)
+    {
+        hash ^= static_cast<unsigned char>(*it);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+unsigned long long
+mix_hash(unsigned long long hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash | 1;
+}
+
+}
+
+
+NegativeCache::NegativeCache(unsigned ttl_secs, size_t max_entries)
+    : m_ttl_ms(static_cast<long long>(ttl_secs)*1000),
+      m_max_entries(max_entries ? max_entries : 1),
+      // Roughly 10 bits per entry gives a ~1% false positive rate with 4 probes.
+      m_bloom_bits(((m_max_entries*10 + 63)/64)*64),
+      m_cur(0),
+      m_hits(0),
+      m_misses(0)
+{
+    long long now = MonotonicMillis();
+    for (unsigned idx = 0; idx < 2; idx++)
+    {
+        std::vector<std::atomic<unsigned long long> > bloom(m_bloom_bits/64);
+        m_gens[idx].m_bloom.swap(bloom);
+        for (size_t word = 0; word < m_gens[idx].m_bloom.size(); word++)
+        {
+            m_gens[idx].m_bloom[word].store(0, std::memory_order_relaxed);
+        }
+        m_gens[idx].m_start = now;
+    }
+}
+
+
+bool
+NegativeCache::BloomTest(const Generation &gen, unsigned long long h1, unsigned long long h2) const
+{
+    for (unsigned idx = 0; idx < m_hash_count; idx++)
+    {
+        size_t bit = (h1 + idx*h2) % m_bloom_bits;
+        if (!(gen.m_bloom[bit/64].load(std::memory_order_relaxed) & (1ULL << (bit % 64))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void
+NegativeCache::BloomSet(Generation &gen, unsigned long long h1, unsigned long long h2)
+{
+    for (unsigned idx = 0; idx < m_hash_count; idx++)
+    {
+        size_t bit = (h1 + idx*h2) % m_bloom_bits;
+        gen.m_bloom[bit/64].fetch_or(1ULL << (bit % 64), std::memory_order_relaxed);
+    }
+}
+
+
+/*
+ * Drop the older generation and start a fresh one.  Caller holds m_mutex.
+ */
+void
+NegativeCache::Rotate(long long now)
+{
+    unsigned next = 1 - m_cur.load();
+    Generation &gen = m_gens[next];
+    for (size_t word = 0; word < gen.m_bloom.size(); word++)
+    {
+        gen.m_bloom[word].store(0, std::memory_order_relaxed);
+    }
+    gen.m_expiry.clear();
+    gen.m_start = now;
+    m_cur.store(next);
+}
+
+
+bool
+NegativeCache::Lookup(const std::string &path)
+{
+    unsigned long long h1 = hash_path(path);
+    unsigned long long h2 = mix_hash(h1);
+
+    // Lock-free fast path: the vast majority of paths were never recorded.
+    if (!BloomTest(m_gens[0], h1, h2) && !BloomTest(m_gens[1], h1, h2))
+    {
+        m_misses++;
+        return false;
+    }
+
+    long long now = MonotonicMillis();
+    XrdSysMutexHelper lock(m_mutex);
+    for (unsigned idx = 0; idx < 2; idx++)
+    {
+        std::unordered_map<std::string, long long>::const_iterator iter = m_gens[idx].m_expiry.find(path);
+        if ((iter != m_gens[idx].m_expiry.end()) && (iter->second > now))
+        {
+            m_hits++;
+            return true;
+        }
+    }
+    m_misses++;
+    return false;
+}
+
+
+void
+NegativeCache::Insert(const std::string &path)
+{
+    unsigned long long h1 = hash_path(path);
+    unsigned long long h2 = mix_hash(h1);
+    long long now = MonotonicMillis();
+
+    XrdSysMutexHelper lock(m_mutex);
+    Generation *gen = &m_gens[m_cur.load()];
+    if ((now - gen->m_start >= m_ttl_ms) || (gen->m_expiry.size() >= m_max_entries/2))
+    {
+        Rotate(now);
+        gen = &m_gens[m_cur.load()];
+    }
+    gen->m_expiry[path] = now + m_ttl_ms;
+    BloomSet(*gen, h1, h2);
+}
+
+
+void
+NegativeCache::Clear(const std::string &path)
+{
+    // The bloom bits stay set until the generation rotates; the exact set is
+    // authoritative so removing the entry there is sufficient.
+    XrdSysMutexHelper lock(m_mutex);
+    m_gens[0].m_expiry.erase(path);
+    m_gens[1].m_expiry.erase(path);
+}
+
+
+DirCache::DirCache(unsigned ttl_secs, size_t max_entries, bool shared)
+    : m_ttl_ms(static_cast<long long>(ttl_secs)*1000),
+      m_max_entries(max_entries),
+      m_shared(shared),
+      m_cond(0),
+      m_entries(0),
+      m_hits(0),
+      m_misses(0),
+      m_waits(0)
+{
+}
+
+
+/*
+ * Remove a slot and account for its entries.  Caller holds m_cond.
+ */
+void
+DirCache::Erase(PathSlots::iterator path_iter, UserSlots::iterator user_iter)
+{
+    Slot &slot = user_iter->second;
+    if (!slot.m_fetch)
+    {
+        m_entries -= slot.m_listing->m_entries.size();
+        m_lru.erase(slot.m_lru);
+    }
+    path_iter->second.erase(user_iter);
+    if (path_iter->second.empty())
+    {
+        m_slots.erase(path_iter);
+    }
+}
+
+
+/*
+ * Remove every user's slot of a path.  A fetch in progress completes for
+ * those already waiting on it, but with its slot gone its result is not kept,
+ * and later callers fetch afresh.  Caller holds m_cond.
+ */
+void
+DirCache::ErasePath(PathSlots::iterator path_iter)
+{
+    while (true)
+    {
+        bool last = (path_iter->second.size() == 1);
+        Erase(path_iter, path_iter->second.begin());
+        if (last) {break;}
+    }
+}
+
+
+/*
+ * Drop least recently used listings until we are within budget.  Caller
+ * holds m_cond.
+ */
+void
+DirCache::Evict()
+{
+    while ((m_entries > m_max_entries) && !m_lru.empty())
+    {
+        const Key &key = m_lru.back();
+        PathSlots::iterator path_iter = m_slots.find(key.first);
+        UserSlots::iterator user_iter = path_iter->second.find(key.second);
+        Erase(path_iter, user_iter);
+    }
+}
+
+
+bool
+DirCache::Acquire(const std::string &path, const std::string &req_user, DirListingRef &listing,
+                  int &retc, FetchRef &fetch)
+{
+    const std::string &user = m_shared ? "" : req_user;
+
+    m_cond.Lock();
+    while (true)
+    {
+        PathSlots::iterator path_iter = m_slots.find(path);
+        UserSlots::iterator user_iter;
+        if ((path_iter == m_slots.end()) ||
+            ((user_iter = path_iter->second.find(user)) == path_iter->second.end()))
+        {
+            // Nobody has this listing; the caller fetches it.
+            fetch = std::make_shared<Fetch>(Key(path, user));
+            m_slots[path][user].m_fetch = fetch;
+            m_cond.UnLock();
+            m_misses++;
+            return false;
+        }
+
+        Slot &slot = user_iter->second;
+        if (slot.m_fetch)
+        {
+            // Wait on the fetch itself rather than the slot: its result is
+            // ours even if it is not kept.
+            FetchRef pending = slot.m_fetch;
+            m_waits++;
+            while (!pending->m_done) {m_cond.Wait();}
+            listing = pending->m_listing;
+            retc = pending->m_retc;
+            m_cond.UnLock();
+            return true;
+        }
+        if (slot.m_expiry <= MonotonicMillis())
+        {
+            Erase(path_iter, user_iter);
+            continue;
+        }
+
+        m_lru.splice(m_lru.begin(), m_lru, slot.m_lru);
+        listing = slot.m_listing;
+        retc = 0;
+        m_cond.UnLock();
+        m_hits++;
+        return true;
+    }
+}
+
+
+/*
+ * Hand the result of `fetch` to its waiters, and keep the listing if it is
+ * still wanted.  Caller holds m_cond.
+ */
+void
+DirCache::Finish(const FetchRef &fetch, const DirListingRef &listing, int retc)
+{
+    fetch->m_done = true;
+    fetch->m_listing = listing;
+    fetch->m_retc = retc;
+
+    // Invalidate drops the slot of a fetch it interrupts; then the listing
+    // may already be out of date.
+    PathSlots::iterator path_iter = m_slots.find(fetch->m_key.first);
+    UserSlots::iterator user_iter;
+    if ((path_iter != m_slots.end()) &&
+        ((user_iter = path_iter->second.find(fetch->m_key.second)) != path_iter->second.end()) &&
+        (user_iter->second.m_fetch == fetch))
+    {
+        Slot &slot = user_iter->second;
+        // Failures, and listings which would take more than a quarter of the
+        // budget, go to the waiters but are not kept.
+        if (!listing || (listing->m_entries.size() > m_max_entries/4))
+        {
+            Erase(path_iter, user_iter);
+        }
+        else
+        {
+            slot.m_listing = listing;
+            slot.m_fetch.reset();
+            slot.m_expiry = MonotonicMillis() + m_ttl_ms;
+            m_lru.push_front(fetch->m_key);
+            slot.m_lru = m_lru.begin();
+            m_entries += listing->m_entries.size();
+            Evict();
+        }
+    }
+    m_cond.Broadcast();
+}
+
+
+void
+DirCache::Publish(const FetchRef &fetch, const DirListingRef &listing)
+{
+    m_cond.Lock();
+    Finish(fetch, listing, 0);
+    m_cond.UnLock();
+}
+
+
+void
+DirCache::Abandon(const FetchRef &fetch, int retc)
+{
+    m_cond.Lock();
+    Finish(fetch, DirListingRef(), retc);
+    m_cond.UnLock();
+}
+
+
+void
+DirCache::Invalidate(const std::string &path)
+{
+    m_cond.Lock();
+    PathSlots::iterator path_iter = m_slots.find(path);
+    if (path_iter != m_slots.end()) {ErasePath(path_iter);}
+    m_cond.UnLock();
+}
+
+
+void
+DirCache::InvalidateTree(const std::string &path)
+{
+    std::string prefix = path;
+    if (prefix.empty() || (prefix[prefix.size()-1] != '/')) {prefix += '/';}
+
+    m_cond.Lock();
+    PathSlots::iterator path_iter = m_slots.find(path);
+    if (path_iter != m_slots.end()) {ErasePath(path_iter);}
+    path_iter = m_slots.lower_bound(prefix);
+    while ((path_iter != m_slots.end()) && !path_iter->first.compare(0, prefix.size(), prefix))
+    {
+        PathSlots::iterator next = path_iter;
+        ++next;
+        ErasePath(path_iter);
+        path_iter = next;
+    }
+    m_cond.UnLock();
+}
+
+
+StatCache::StatCache(unsigned ttl_secs, size_t max_entries, unsigned burst)
+    : m_ttl_ms(static_cast<long long>(ttl_secs)*1000),
+      m_max_entries(max_entries),
+      m_burst(burst ? burst : 1),
+      m_count(0),
+      m_hits(0),
+      m_misses(0),
+      m_prefetches(0)
+{
+}
+
+
+bool
+StatCache::Lookup(const std::string &path, const std::string &user, struct stat &buf)
+{
+    XrdSysMutexHelper lock(m_mutex);
+    PathEntries::iterator path_iter = m_entries.find(path);
+    if (path_iter != m_entries.end())
+    {
+        UserEntries::const_iterator user_iter = path_iter->second.find(user);
+        if ((user_iter != path_iter->second.end()) && (user_iter->second.m_expiry > MonotonicMillis()))
+        {
+            buf = user_iter->second.m_stat;
+            m_hits++;
+            return true;
+        }
+    }
+    m_misses++;
+    return false;
+}
+
+
+/*
+ * The burst state of `key`, moved to the current generation.  Caller holds
+ * m_mutex.
+ */
+StatCache::Burst &
+StatCache::FindBurst(const std::string &key)
+{
+    Bursts::iterator iter = m_bursts.find(key);
+    if (iter != m_bursts.end()) {return iter->second;}
+
+    Burst burst;
+    iter = m_old_bursts.find(key);
+    if (iter != m_old_bursts.end())
+    {
+        burst = iter->second;
+        m_old_bursts.erase(iter);
+    }
+    if (m_bursts.size() >= MaxBursts)
+    {
+        // Directories not heard of for a whole generation have gone quiet.
+        m_old_bursts.swap(m_bursts);
+        m_bursts.clear();
+    }
+    return m_bursts[key] = burst;
+}
+
+
+bool
+StatCache::NoteMiss(const std::string &parent, const std::string &user)
+{
+    if (parent.empty()) {return false;}
+
+    long long now = MonotonicMillis();
+    std::string key = user + ":" + parent;
+
+    XrdSysMutexHelper lock(m_mutex);
+    Burst &burst = FindBurst(key);
+    if (burst.m_active || (burst.m_next_prefetch > now))
+    {
+        return false;
+    }
+    if (now - burst.m_window_start > 1000)
+    {
+        burst.m_window_start = now;
+        burst.m_count = 0;
+    }
+    if (++burst.m_count < m_burst)
+    {
+        return false;
+    }
+    burst.m_active = true;
+    m_prefetches++;
+    return true;
+}
+
+
+void
+StatCache::PrefetchDone(const std::string &parent, const std::string &user, bool too_big)
+{
+    XrdSysMutexHelper lock(m_mutex);
+    Burst &burst = FindBurst(user + ":" + parent);
+    burst.m_active = false;
+    burst.m_count = 0;
+    burst.m_next_prefetch = MonotonicMillis() + m_ttl_ms;
+    if (too_big) {burst.m_next_prefetch += TooBigRetryMs;}
+}
+
+
+/*
+ * Drop expired entries, and then the oldest until there is room for `room`
+ * more.  Caller holds m_mutex.
+ */
+void
+StatCache::Prune(long long now, size_t room)
+{
+    while (!m_ages.empty() &&
+           ((m_ages.front().m_expiry <= now) || (m_count + room > m_max_entries)))
+    {
+        const Age &age = m_ages.front();
+        PathEntries::iterator path_iter = m_entries.find(age.m_path);
+        UserEntries::iterator user_iter;
+        if ((path_iter != m_entries.end()) &&
+            ((user_iter = path_iter->second.find(age.m_user)) != path_iter->second.end()) &&
+            (user_iter->second.m_expiry == age.m_expiry))
+        {
+            path_iter->second.erase(user_iter);
+            if (path_iter->second.empty()) {m_entries.erase(path_iter);}
+            m_count--;
+        }
+        m_ages.pop_front();
+    }
+}
+
+
+void
+StatCache::Insert(const Stats &stats, const std::string &user)
+{
+    long long now = MonotonicMillis();
+    long long expiry = now + m_ttl_ms;
+
+    XrdSysMutexHelper lock(m_mutex);
+    Prune(now, stats.size());
+    for (Stats::const_iterator iter = stats.begin(); iter != stats.end(); ++iter)
+    {
+        UserEntries &entries = m_entries[iter->first];
+        std::pair<UserEntries::iterator, bool> result = entries.insert(std::make_pair(user, Entry()));
+        if (result.second) {m_count++;}
+        result.first->second.m_stat = iter->second;
+        result.first->second.m_expiry = expiry;
+        Age age;
+        age.m_path = iter->first;
+        age.m_user = user;
+        age.m_expiry = expiry;
+        m_ages.push_back(age);
+    }
+}
+
+
+void
+StatCache::Invalidate(const std::string &path)
+{
+    XrdSysMutexHelper lock(m_mutex);
+    PathEntries::iterator path_iter = m_entries.find(path);
+    if (path_iter != m_entries.end())
+    {
+        m_count -= path_iter->second.size();
+        m_entries.erase(path_iter);
+    }
+}
+
+
+void
+StatCache::InvalidateTree(const std::string &path)
+{
+    std::string prefix = path;
+    if (prefix.empty() || (prefix[prefix.size()-1] != '/')) {prefix += '/';}
+
+    Invalidate(path);
+    XrdSysMutexHelper lock(m_mutex);
+    PathEntries::iterator path_iter = m_entries.lower_bound(prefix);
+    while ((path_iter != m_entries.end()) && !path_iter->first.compare(0, prefix.size(), prefix))
+    {
+        m_count -= path_iter->second.size();
+        m_entries.erase(path_iter++);
+    }
+}
@@ -0,0 +1,302 @@
+
+/*
+ * Metadata caches used by the Xrootd HDFS plugin to avoid namenode RPCs.
+ */
+
+#ifndef __XRDHDFS_CACHE_H__
+#define __XRDHDFS_CACHE_H__
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace XrdHdfs {
+
+// Milliseconds on the monotonic clock; used for all cache expiry decisions.
+long long MonotonicMillis();
+
+/*
+ * A short-lived cache of paths known *not* to exist.
+ *
+ * The cmsd asks every server in a federation about files most of them do not
+ * have; without this cache, each of those probes is a failed hdfsGetPathInfo.
+ *
+ * Entries are kept in two generations, each consisting of a bloom filter and
+ * an exact set.  The bloom filters are consulted without taking a lock, so a
+ * path which was never recorded missing costs only a few memory reads.  When a
+ * generation is older than the TTL (or full), the older generation is dropped
+ * wholesale; this is how we "delete" from the bloom filters.
+ */
+class NegativeCache
+{
+public:
+    NegativeCache(unsigned ttl_secs, size_t max_entries);
+
+    // Returns true if `path` was recently found to not exist.
+    bool Lookup(const std::string &path);
+
+    // Record that `path` does not exist.
+    void Insert(const std::string &path);
+
+    // Forget `path`; called when we create or rename something onto it.
+    void Clear(const std::string &path);
+
+    unsigned long long Hits() const {return m_hits;}
+    unsigned long long Misses() const {return m_misses;}
+
+private:
+    NegativeCache(NegativeCache const &);
+    NegativeCache & operator=(NegativeCache const &);
+
+    struct Generation
+    {
+        std::vector<std::atomic<unsigned long long> > m_bloom;
+        std::unordered_map<std::string, long long> m_expiry;
+        long long m_start;
+    };
+
+    static const unsigned m_hash_count = 4;
+
+    bool BloomTest(const Generation &gen, unsigned long long h1, unsigned long long h2) const;
+    void BloomSet(Generation &gen, unsigned long long h1, unsigned long long h2);
+    void Rotate(long long now);
+
+    const long long m_ttl_ms;
+    const size_t m_max_entries;
+    const size_t m_bloom_bits;
+
+    XrdSysMutex m_mutex;
+    Generation m_gens[2];
+    std::atomic<unsigned> m_cur;
+
+    std::atomic<unsigned long long> m_hits;
+    std::atomic<unsigned long long> m_misses;
+};
+
+
+/*
+ * One entry of a directory listing, already in the form Readdir returns it.
+ */
+struct DirEntry
+{
+    std::string m_name;
+    struct stat m_stat;
+};
+
+struct DirListing
+{
+    std::vector<DirEntry> m_entries;
+};
+
+typedef std::shared_ptr<const DirListing> DirListingRef;
+
+/*
+ * A bounded, TTL-based cache of directory listings.
+ *
+ * Listings are immutable and reference-counted, so a directory handle keeps
+ * its listing alive even if it is evicted or invalidated while being read.
+ * Only one caller fetches a given listing at a time; concurrent opendirs of
+ * the same directory wait for that fetch and share its result -- or its
+ * error -- even when the listing is too big to keep, or was invalidated
+ * while being fetched.  Those are only not kept for later callers.
+ *
+ * HDFS permission checks depend on the identity doing the listing, so unless
+ * the cache is configured as shared, listings are kept per user.
+ */
+class DirCache
+{
+public:
+    DirCache(unsigned ttl_secs, size_t max_entries, bool shared);
+
+    // A fetch of a listing in progress; waited on by concurrent callers.
+    struct Fetch;
+    typedef std::shared_ptr<Fetch> FetchRef;
+
+    // Look up the listing of `path` as seen by `user`.  On a hit, or once
+    // another caller's fetch of it finishes, true is returned with `listing`
+    // set, or with `retc` set to the failed fetch's -errno.  Otherwise false
+    // is returned and the caller must fetch the listing and hand it to
+    // Publish() along with `fetch` -- or call Abandon() if the fetch failed.
+    bool Acquire(const std::string &path, const std::string &user, DirListingRef &listing,
+                 int &retc, FetchRef &fetch);
+
+    void Publish(const FetchRef &fetch, const DirListingRef &listing);
+
+    void Abandon(const FetchRef &fetch, int retc);
+
+    // Drop all cached listings of `path`; called after namespace mutations.
+    void Invalidate(const std::string &path);
+
+    // Drop those of `path` and of every directory below it; called after a
+    // directory is renamed or removed.
+    void InvalidateTree(const std::string &path);
+
+    unsigned long long Hits() const {return m_hits;}
+    unsigned long long Misses() const {return m_misses;}
+    unsigned long long Waits() const {return m_waits;}
+
+private:
+    DirCache(DirCache const &);
+    DirCache & operator=(DirCache const &);
+
+    typedef std::pair<std::string, std::string> Key; // (path, user)
+
+    struct Slot
+    {
+        Slot() : m_expiry(0) {}
+
+        DirListingRef m_listing;
+        long long m_expiry;
+        FetchRef m_fetch;   // Set while a fetch is in progress.
+        std::list<Key>::iterator m_lru;
+    };
+
+    // Paths are ordered so a directory's subtree is one range.
+    typedef std::unordered_map<std::string, Slot> UserSlots;
+    typedef std::map<std::string, UserSlots> PathSlots;
+
+    void Erase(PathSlots::iterator path_iter, UserSlots::iterator user_iter);
+    void ErasePath(PathSlots::iterator path_iter);
+    void Evict();
+    void Finish(const FetchRef &fetch, const DirListingRef &listing, int retc);
+
+    const long long m_ttl_ms;
+    const size_t m_max_entries;
+    const bool m_shared;
+
+    XrdSysCondVar m_cond;
+    PathSlots m_slots;
+    std::list<Key> m_lru;   // Ready listings, most recently used first.
+    size_t m_entries;       // Total entries across all cached listings.
+
+    std::atomic<unsigned long long> m_hits;
+    std::atomic<unsigned long long> m_misses;
+    std::atomic<unsigned long long> m_waits;
+};
+
+
+struct DirCache::Fetch
+{
+    explicit Fetch(const Key &key) : m_key(key), m_done(false), m_retc(0) {}
+
+    const Key m_key;
+    bool m_done;
+    DirListingRef m_listing; // Once done: the listing, or NULL and m_retc.
+    int m_retc;
+};
+
+
+/*
+ * A short-lived cache of stat results, filled by directory-scoped prefetch.
+ *
+ * Workflows commonly stat every file in a directory one after another.  The
+ * cache watches stat misses per parent directory; once `burst` misses land in
+ * the same directory within a second, NoteMiss asks the caller to list the
+ * directory once and Insert every sibling, so the remaining stats are served
+ * from memory.  Entries are kept per user, as with the DirCache.
+ *
+ * Directories with more than PrefetchLimit() entries are not prefetched, and
+ * not tried again for a while.  When full, the oldest entries are evicted.
+ * Burst tracking is kept in two generations, the older dropped wholesale once
+ * the newer fills up, so noting a miss never scans the whole table.
+ */
+class StatCache
+{
+public:
+    typedef std::vector<std::pair<std::string, struct stat> > Stats;
+
+    StatCache(unsigned ttl_secs, size_t max_entries, unsigned burst);
+
+    bool Lookup(const std::string &path, const std::string &user, struct stat &buf);
+
+    // Note a stat of a child of `parent` which missed the cache.  Returns true
+    // if the caller should now prefetch `parent`; it must then call
+    // PrefetchDone() when finished, saying whether the directory had more
+    // than PrefetchLimit() entries.
+    bool NoteMiss(const std::string &parent, const std::string &user);
+
+    void PrefetchDone(const std::string &parent, const std::string &user, bool too_big);
+
+    // The most entries a directory may have to be prefetched.
+    size_t PrefetchLimit() const {return m_max_entries/4;}
+
+    // Insert the (path, stat) pairs of a prefetch, under one lock.
+    void Insert(const Stats &stats, const std::string &user);
+
+    void Invalidate(const std::string &path);
+
+    // Also drop the entries of everything below `path`.
+    void InvalidateTree(const std::string &path);
+
+    unsigned long long Hits() const {return m_hits;}
+    unsigned long long Misses() const {return m_misses;}
+    unsigned long long Prefetches() const {return m_prefetches;}
+
+private:
+    StatCache(StatCache const &);
+    StatCache & operator=(StatCache const &);
+
+    struct Entry
+    {
+        struct stat m_stat;
+        long long m_expiry;
+    };
+
+    struct Burst
+    {
+        Burst() : m_window_start(0), m_count(0), m_next_prefetch(0), m_active(false) {}
+
+        long long m_window_start;
+        unsigned m_count;
+        long long m_next_prefetch; // Do not list the directory again before this.
+        bool m_active;             // A prefetch is in progress.
+    };
+
+    // An entry in insertion order; all entries live for the same TTL, so
+    // this is also the order in which they expire.
+    struct Age
+    {
+        std::string m_path;
+        std::string m_user;
+        long long m_expiry; // Stale if the entry has since been replaced.
+    };
+
+    // Paths are ordered so a directory's subtree is one range.
+    typedef std::unordered_map<std::string, Entry> UserEntries;
+    typedef std::map<std::string, UserEntries> PathEntries;
+    typedef std::unordered_map<std::string, Burst> Bursts;
+
+    void Prune(long long now, size_t room);
+    Burst &FindBurst(const std::string &key);
+
+    static const size_t MaxBursts = 4096;
+    static const long long TooBigRetryMs = 600000;
+
+    const long long m_ttl_ms;
+    const size_t m_max_entries;
+    const unsigned m_burst;
+
+    XrdSysMutex m_mutex;
+    PathEntries m_entries;
+    std::deque<Age> m_ages;
+    Bursts m_bursts;     // Keyed by user + parent.
+    Bursts m_old_bursts; // The previous generation of m_bursts.
+    size_t m_count;
+
+    std::atomic<unsigned long long> m_hits;
+    std::atomic<unsigned long long> m_misses;
+    std::atomic<unsigned long long> m_prefetches;
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+
+#include "XrdHdfsCalls.hh"
+#include "XrdHdfsBackend.hh"
+#include "XrdHdfsLatency.hh"
+#include "XrdHdfsSched.hh"
+#include "XrdHdfsWorkers.hh"
+
+using namespace XrdHdfs;
+
+// Calls are timed on the calling thread, not in the job a JNI worker runs, so
+// they count towards the phases of the caller's operation (see OpTraceLeave).
+
+
+hdfsFS
+Hdfs::ConnectAsUserNewInstance(const char *nn, tPort port, const char *user)
+{
+    LatencyTimer timer(LatHdfsConnect);
+    return CallHdfs([&]() {return g_backend.ConnectAsUserNewInstance(nn, port, user);});
+}
+
+
+int
+Hdfs::Disconnect(hdfsFS fs)
+{
+    LatencyTimer timer(LatHdfsDisconnect);
+    return CallHdfs([&]() {return g_backend.Disconnect(fs);});
+}
+
+
+hdfsFileInfo *
+Hdfs::GetPathInfo(hdfsFS fs, const char *path)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsGetPathInfo);
+    return CallHdfs([&]() {return g_backend.GetPathInfo(fs, path);});
+}
+
+
+hdfsFileInfo *
+Hdfs::ListDirectory(hdfsFS fs, const char *path, int *numEntries)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsListDirectory);
+    return CallHdfs([&]() {return g_backend.ListDirectory(fs, path, numEntries);});
+}
+
+
+void
+Hdfs::FreeFileInfo(hdfsFileInfo *info, int numEntries)
+{
+    g_backend.FreeFileInfo(info, numEntries);
+}
+
+
+int
+Hdfs::Exists(hdfsFS fs, const char *path)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsExists);
+    return CallHdfs([&]() {return g_backend.Exists(fs, path);});
+}
+
+
+int
+Hdfs::CreateDirectory(hdfsFS fs, const char *path)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsCreateDirectory);
+    return CallHdfs([&]() {return g_backend.CreateDirectory(fs, path);});
+}
+
+
+int
+Hdfs::Chmod(hdfsFS fs, const char *path, short mode)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsChmod);
+    return CallHdfs([&]() {return g_backend.Chmod(fs, path, mode);});
+}
+
+
+int
+Hdfs::Delete(hdfsFS fs, const char *path, int recursive)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsDelete);
+    return CallHdfs([&]() {return g_backend.Delete(fs, path, recursive);});
+}
+
+
+int
+Hdfs::Rename(hdfsFS fs, const char *oldPath, const char *newPath)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsRename);
+    return CallHdfs([&]() {return g_backend.Rename(fs, oldPath, newPath);});
+}
+
+
+hdfsFile
+Hdfs::OpenFile(hdfsFS fs, const char *path, int flags, int bufferSize,
+               short replication, tSize blocksize)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsOpenFile);
+    return CallHdfs([&]() {return g_backend.OpenFile(fs, path, flags, bufferSize, replication, blocksize);});
+}
+
+
+int
+Hdfs::CloseFile(hdfsFS fs, hdfsFile file)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsCloseFile);
+    return CallHdfs([&]() {return g_backend.CloseFile(fs, file);});
+}
+
+
+// Answered from the open stream, without an RPC, so neither scheduled nor
+// timed.
+int
+Hdfs::Available(hdfsFS fs, hdfsFile file)
+{
+    return CallHdfs([&]() {return g_backend.Available(fs, file);});
+}
+
+
+tSize
+Hdfs::Pread(hdfsFS fs, hdfsFile file, tOffset position, void *buffer, tSize length)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsPread);
+    return CallHdfs([&]() {return g_backend.Pread(fs, file, position, buffer, length);});
+}
+
+
+tSize
+Hdfs::Write(hdfsFS fs, hdfsFile file, const void *buffer, tSize length)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsWrite);
+    return CallHdfs([&]() {return g_backend.Write(fs, file, buffer, length);});
+}
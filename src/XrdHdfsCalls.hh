@@ -0,0 +1,45 @@
+
+/*
+ * The libhdfs calls made by the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_CALLS_H__
+#define __XRDHDFS_CALLS_H__
+
+#include "hdfs.h"
+
+namespace XrdHdfs {
+
+/*
+ * Each function has the signature and semantics (including errno) of the
+ * libhdfs function of the same name.  Going through these rather than calling
+ * libhdfs directly lets the plugin decide where each call runs -- for
+ * example, on a dedicated JNI worker thread -- and which client library
+ * serves it (see XrdHdfsBackend.hh).
+ */
+namespace Hdfs {
+
+hdfsFS ConnectAsUserNewInstance(const char *nn, tPort port, const char *user);
+int Disconnect(hdfsFS fs);
+
+hdfsFileInfo *GetPathInfo(hdfsFS fs, const char *path);
+hdfsFileInfo *ListDirectory(hdfsFS fs, const char *path, int *numEntries);
+void FreeFileInfo(hdfsFileInfo *info, int numEntries);
+int Exists(hdfsFS fs, const char *path);
+int CreateDirectory(hdfsFS fs, const char *path);
+int Chmod(hdfsFS fs, const char *path, short mode);
+int Delete(hdfsFS fs, const char *path, int recursive);
+int Rename(hdfsFS fs, const char *oldPath, const char *newPath);
+
+hdfsFile OpenFile(hdfsFS fs, const char *path, int flags, int bufferSize,
+                  short replication, tSize blocksize);
+int CloseFile(hdfsFS fs, hdfsFile file);
+int Available(hdfsFS fs, hdfsFile file);
+tSize Pread(hdfsFS fs, hdfsFile file, tOffset position, void *buffer, tSize length);
+tSize Write(hdfsFS fs, hdfsFile file, const void *buffer, tSize length);
+
+}
+
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include "XrdVersion.hh"
 
 #include "XrdHdfsChecksum.hh"
+#include "XrdHdfsFlight.hh"
+#include "XrdHdfsTrace.hh"
 
 #include "XrdOss/XrdOss.hh"
 #include "XrdSfs/XrdSfsInterface.hh"
@@ -20,6 +22,15 @@ typedef std::vector<ChecksumValue> ChecksumValues;
 
 extern XrdOss *g_hdfs_oss;
 
+namespace {
+
+// The result of reading one checksum file: 0 or -errno, plus its contents.
+typedef std::pair<int, std::string> FileContents;
+
+SingleFlight<FileContents> g_contents_flight;
+
+}
+
 extern "C" {
 
 XrdCks *XrdCksInit(XrdSysError *eDest,
@@ -28,7 +39,11 @@ XrdCks *XrdCksInit(XrdSysError *eDest,
 {
     XrdCks *cks = new ChecksumManager(*eDest);
     eDest->Emsg("ChecksumManager", "Initializing checksum manager with config file", config_fn);
-    cks->Init(config_fn);
+    if (!cks->Init(config_fn))
+    {
+        delete cks;
+        return NULL;
+    }
     return cks;
 }
 
@@ -44,8 +59,34 @@ ChecksumManager::ChecksumManager(XrdSysError& log)
 }
 
 
+void
+ChecksumManager::CoalesceCounts(unsigned long long &calls, unsigned long long &collapsed)
+{
+    calls = g_contents_flight.Calls();
+    collapsed = g_contents_flight.Collapsed();
+}
+
+
+/*
+ * Many clients ask for the checksum of a newly-released file at once; only
+ * one of them actually reads the checksum file from HDFS.
+ */
 int
 ChecksumManager::GetFileContents(const char *pfn, std::string &result) const
+{
+    FileContents contents;
+    g_contents_flight.Do(pfn, contents, [this, pfn](FileContents &value) {
+        value.second.clear();
+        value.first = ReadFileContents(pfn, value.second);
+    });
+    if (contents.first) {return contents.first;}
+    result.swap(contents.second);
+    return 0;
+}
+
+
+int
+ChecksumManager::ReadFileContents(const char *pfn, std::string &result) const
 {
     if (!g_hdfs_oss) {return -ENOMEM;}
 
@@ -151,12 +192,18 @@ ChecksumManager::Parse(const std::string &checksum_contents, ChecksumValues &res
 
 
 int
-ChecksumManager::Init(const char * /*config_fn*/, const char *default_checksum)
+ChecksumManager::Init(const char *config_fn, const char *default_checksum)
 {
     if (default_checksum)
     {
         m_default_digest = default_checksum;
     }
+    // Loaded as the ckslib, this module has its own copy of the trace, which
+    // the oss plugin's configuration never reaches.
+    if (ConfigTrace(m_log, config_fn))
+    {
+        return 0;
+    }
     return 1;
 }
 
@@ -211,9 +258,7 @@ ChecksumManager::Get(const char *pfn, XrdCksData &cks)
         return -ESRCH;
     }
 
-    std::stringstream ss2;
-    ss2 << "Got checksum (" << requested_checksum << ":" << checksum_value << ") for " << pfn;
-    m_log.Emsg("Get", ss2.str().c_str());
+    HDFS_TRACE(Cksum, "Get", "Got checksum (%s:%s) for %s", requested_checksum, checksum_value.c_str(), pfn);
 
     if (checksum_value.size() > cks.ValuSize)
     {
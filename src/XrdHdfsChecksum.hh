@@ -93,6 +93,10 @@ public:
 
     virtual ~ChecksumManager() {}
 
+    // How many checksum file reads were requested, and how many of those
+    // shared the result of an identical read already in progress.
+    static void CoalesceCounts(unsigned long long &calls, unsigned long long &collapsed);
+
     enum ChecksumTypes {
         MD5     = 0x01,
         CKSUM   = 0x02,
@@ -112,6 +116,7 @@ private:
 
     std::string GetChecksumFilename(const char *pfn) const;
     int GetFileContents(const char *pfn, std::string &contents) const;
+    int ReadFileContents(const char *pfn, std::string &contents) const;
     int Parse(const std::string &chksum_contents, ChecksumValues &result);
     int SetMultiple(const char *pfn, const ChecksumValues &values) const;
 
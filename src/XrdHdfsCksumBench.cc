@@ -0,0 +1,352 @@
+
+/*
+ * Throughput benchmark for ChecksumState, which hashes every byte written
+ * through the plugin and every byte read by ChecksumManager::Calc.
+ *
+ * First checks each digest against reference vectors, feeding them in
+ * pieces of every benchmarked buffer size, and exits 1 on any mismatch.
+ * Then, for each digest set and buffer size, hashes the same data in memory
+ * from each thread and prints one JSON object per run on stdout:
+ *
+ *     {"digests":"all","buffer":1048576,"threads":1,"bytes":...,
+ *      "seconds":...,"gb_per_s":...,"gb_per_s_per_core":...}
+ *
+ * gb_per_s_per_core is based on the CPU time of the hashing threads.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "XrdOss/XrdOss.hh"
+
+#include "XrdHdfsChecksum.hh"
+
+using namespace XrdHdfs;
+
+// ChecksumManager reads and writes checksum files through the plugin, which
+// is not loaded here.
+XrdOss *g_hdfs_oss = NULL;
+
+namespace
+{
+
+struct DigestInfo
+{
+    const char *m_name;
+    unsigned m_digest;
+};
+
+const DigestInfo g_digests[] =
+{
+    {"adler32", ChecksumManager::ADLER32},
+    {"crc32",   ChecksumManager::CRC32},
+    {"cksum",   ChecksumManager::CKSUM},
+    {"md5",     ChecksumManager::MD5},
+    {"cvmfs",   ChecksumManager::CVMFS}
+};
+const size_t g_digest_count = sizeof(g_digests) / sizeof(g_digests[0]);
+
+// Outputs of zlib, OpenSSL and coreutils' cksum for the same inputs.
+struct Reference
+{
+    const char *m_name;
+    std::string m_data;
+    const char *m_adler32;
+    const char *m_crc32;
+    const char *m_cksum;
+    const char *m_md5;
+    const char *m_sha1;
+};
+
+std::vector<Reference>
+References()
+{
+    std::vector<Reference> refs;
+    Reference empty = {"empty", "", "00000001", "00000000", "4294967295",
+                       "d41d8cd98f00b204e9800998ecf8427e", "da39a3ee5e6b4b0d3255bfef95601890afd80709"};
+    Reference check = {"123456789", "123456789", "091e01de", "cbf43926", "930766865",
+                       "25f9e794323b453885f5181f1b624d0b", "f7c3bc1d808e04732adf679965ccc34ca7ae3441"};
+    Reference million = {"a*1000000", std::string(1000000, 'a'), "15d870f9", "dc25bfbc", "3401932319",
+                         "7707d6ae4e027c70eea2a935c2296f21", "34aa973cd4c4daa4f61eeb2bdbad27316534016f"};
+    refs.push_back(empty);
+    refs.push_back(check);
+    refs.push_back(million);
+    return refs;
+}
+
+
+std::string
+Expected(const Reference &ref, unsigned digest)
+{
+    switch (digest)
+    {
+    case ChecksumManager::ADLER32: return ref.m_adler32;
+    case ChecksumManager::CRC32: return ref.m_crc32;
+    case ChecksumManager::CKSUM: return ref.m_cksum;
+    case ChecksumManager::MD5: return ref.m_md5;
+    }
+    char graft[256];
+    snprintf(graft, sizeof(graft), "size=%zu;checksum=%s;chunk_offsets=0;chunk_checksums=%s",
+             ref.m_data.size(), ref.m_sha1, ref.m_sha1);
+    return graft;
+}
+
+
+// Check every digest, computed together, against the references when fed in
+// `piece` byte updates.  Returns the number of mismatches.
+int
+Verify(const Reference &ref, size_t piece)
+{
+    ChecksumState state(ChecksumManager::ALL);
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(ref.m_data.data());
+    for (size_t offset = 0; offset < ref.m_data.size(); offset += piece)
+    {
+        state.Update(data + offset, std::min(piece, ref.m_data.size() - offset));
+    }
+    state.Finalize();
+
+    int failures = 0;
+    for (size_t idx = 0; idx < g_digest_count; idx++)
+    {
+        std::string got = state.Get(g_digests[idx].m_digest);
+        std::string want = Expected(ref, g_digests[idx].m_digest);
+        if (got != want)
+        {
+            fprintf(stderr, "%s of %s in %zu byte pieces: got %s, expected %s\n",
+                    g_digests[idx].m_name, ref.m_name, piece, got.c_str(), want.c_str());
+            failures++;
+        }
+    }
+    return failures;
+}
+
+
+double
+Clock(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+struct Worker
+{
+    const std::vector<unsigned char> *m_data;
+    unsigned m_digests;
+    size_t m_buffer;
+    size_t m_total;
+    double m_cpu_seconds;
+};
+
+
+void *
+RunWorker(void *arg)
+{
+    Worker &worker = *static_cast<Worker *>(arg);
+    const std::vector<unsigned char> &data = *worker.m_data;
+
+    double start = Clock(CLOCK_THREAD_CPUTIME_ID);
+    ChecksumState state(worker.m_digests);
+    size_t done = 0, offset = 0;
+    while (done < worker.m_total)
+    {
+        if (offset + worker.m_buffer > data.size()) {offset = 0;}
+        state.Update(&data[offset], worker.m_buffer);
+        offset += worker.m_buffer;
+        done += worker.m_buffer;
+    }
+    state.Finalize();
+    worker.m_cpu_seconds = Clock(CLOCK_THREAD_CPUTIME_ID) - start;
+    return NULL;
+}
+
+
+void
+Run(const std::string &name, unsigned digests, size_t buffer, int threads,
+    const std::vector<unsigned char> &data, size_t total)
+{
+    // Hash at least one full buffer, and whole buffers only.
+    total = std::max(buffer, total / buffer * buffer);
+
+    std::vector<Worker> workers(threads);
+    std::vector<pthread_t> tids(threads);
+    double start = Clock(CLOCK_MONOTONIC);
+    for (int idx = 0; idx < threads; idx++)
+    {
+        workers[idx].m_data = &data;
+        workers[idx].m_digests = digests;
+        workers[idx].m_buffer = buffer;
+        workers[idx].m_total = total;
+        workers[idx].m_cpu_seconds = 0;
+        if (pthread_create(&tids[idx], NULL, RunWorker, &workers[idx]))
+        {
+            fprintf(stderr, "Failed to start a benchmark thread\n");
+            exit(1);
+        }
+    }
+    double cpu_seconds = 0;
+    for (int idx = 0; idx < threads; idx++)
+    {
+        pthread_join(tids[idx], NULL);
+        cpu_seconds += workers[idx].m_cpu_seconds;
+    }
+    double seconds = Clock(CLOCK_MONOTONIC) - start;
+    double bytes = static_cast<double>(total) * threads;
+
+    printf("{\"digests\":\"%s\",\"buffer\":%zu,\"threads\":%d,\"bytes\":%.0f,\"seconds\":%.3f,"
+           "\"gb_per_s\":%.3f,\"gb_per_s_per_core\":%.3f}\n",
+           name.c_str(), buffer, threads, bytes, seconds,
+           bytes / seconds / 1e9, cpu_seconds > 0 ? bytes / cpu_seconds / 1e9 : 0.0);
+    fflush(stdout);
+}
+
+
+// Parse a digest set such as "adler32", "md5+crc32" or "all".
+bool
+ParseDigests(const std::string &name, unsigned &digests)
+{
+    if (name == "all") {digests = ChecksumManager::ALL; return true;}
+    digests = 0;
+    size_t start = 0;
+    while (start <= name.size())
+    {
+        size_t end = name.find('+', start);
+        if (end == std::string::npos) {end = name.size();}
+        std::string part = name.substr(start, end - start);
+        unsigned found = 0;
+        for (size_t idx = 0; idx < g_digest_count; idx++)
+        {
+            if (part == g_digests[idx].m_name) {found = g_digests[idx].m_digest;}
+        }
+        if (!found) {return false;}
+        digests |= found;
+        start = end + 1;
+    }
+    return true;
+}
+
+
+void
+Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-s total_mb] [-t threads] [-b size_kb,...] [digests ...]\n"
+        "\n"
+        "  -s  MiB hashed per thread and run (256).\n"
+        "  -t  threads hashing concurrently, each with its own state (1).\n"
+        "  -b  comma-separated buffer sizes in KiB (4,64,256,1024,4096,16384).\n"
+        "  -V  only check the reference vectors.\n"
+        "\n"
+        "Digest sets are digests joined by '+', from adler32, crc32, cksum, md5\n"
+        "and cvmfs, or 'all'.  The default is each digest alone, then 'all' as\n"
+        "written files and ChecksumManager::Calc use.\n",
+        prog);
+}
+
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    size_t total = 256*1024*1024;
+    int threads = 1;
+    bool verify_only = false;
+    std::vector<size_t> buffers;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:t:b:Vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': total = strtoull(optarg, NULL, 10) * 1024 * 1024; break;
+        case 't': threads = atoi(optarg); break;
+        case 'V': verify_only = true; break;
+        case 'b':
+            for (char *tok = strtok(optarg, ","); tok; tok = strtok(NULL, ","))
+            {
+                buffers.push_back(strtoull(tok, NULL, 10) * 1024);
+            }
+            break;
+        default:
+            Usage(argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if (buffers.empty())
+    {
+        for (size_t size = 4*1024; size <= 16*1024*1024; size *= 4) {buffers.push_back(size);}
+    }
+    for (size_t idx = 0; idx < buffers.size(); idx++)
+    {
+        if (!buffers[idx]) {Usage(argv[0]); return 2;}
+    }
+    if ((threads <= 0) || !total) {Usage(argv[0]); return 2;}
+
+    std::vector<std::pair<std::string, unsigned> > sets;
+    for (int idx = optind; idx < argc; idx++)
+    {
+        unsigned digests;
+        if (!ParseDigests(argv[idx], digests))
+        {
+            fprintf(stderr, "Unknown digest set %s\n", argv[idx]);
+            Usage(argv[0]);
+            return 2;
+        }
+        sets.push_back(std::make_pair(std::string(argv[idx]), digests));
+    }
+    if (sets.empty())
+    {
+        for (size_t idx = 0; idx < g_digest_count; idx++)
+        {
+            sets.push_back(std::make_pair(std::string(g_digests[idx].m_name), g_digests[idx].m_digest));
+        }
+        sets.push_back(std::make_pair(std::string("all"), static_cast<unsigned>(ChecksumManager::ALL)));
+    }
+
+    // Odd piece sizes catch mistakes carrying state across unaligned updates.
+    std::vector<size_t> pieces(buffers);
+    pieces.push_back(1);
+    pieces.push_back(7);
+    pieces.push_back(4093);
+    std::vector<Reference> refs = References();
+    int failures = 0;
+    for (size_t ridx = 0; ridx < refs.size(); ridx++)
+    {
+        for (size_t pidx = 0; pidx < pieces.size(); pidx++)
+        {
+            failures += Verify(refs[ridx], pieces[pidx]);
+        }
+    }
+    if (failures)
+    {
+        fprintf(stderr, "%d checksums differ from the reference vectors\n", failures);
+        return 1;
+    }
+    if (verify_only) {return 0;}
+
+    // Incompressible data, as most stored files are.
+    size_t data_size = 64*1024*1024;
+    for (size_t idx = 0; idx < buffers.size(); idx++) {data_size = std::max(data_size, buffers[idx]);}
+    std::vector<unsigned char> data(data_size);
+    unsigned seed = 1;
+    for (size_t idx = 0; idx < data.size(); idx++) {data[idx] = rand_r(&seed);}
+
+    for (size_t sidx = 0; sidx < sets.size(); sidx++)
+    {
+        for (size_t bidx = 0; bidx < buffers.size(); bidx++)
+        {
+            Run(sets[sidx].first, sets[sidx].second, buffers[bidx], threads, data, total);
+        }
+    }
+    return 0;
+}
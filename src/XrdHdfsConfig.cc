@@ -18,15 +18,28 @@ const char *XrdHdfsConfigCVSID = "$Id$";
 #include <sys/param.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+
 #include "XrdVersion.hh"
 #include "XrdOuc/XrdOucEnv.hh"
+#include "XrdOuc/XrdOuca2x.hh"
 #include "XrdSys/XrdSysError.hh"
 #include "XrdSys/XrdSysHeaders.hh"
 #include "XrdSys/XrdSysLogger.hh"
 #include "XrdSys/XrdSysPlugin.hh"
 #include "XrdSys/XrdSysPthread.hh"
+#include "XrdSys/XrdSysTimer.hh"
 #include "XrdSec/XrdSecInterface.hh"
 #include "XrdHdfs.hh"
+#include "XrdHdfsAccounting.hh"
+#include "XrdHdfsBackend.hh"
+#include "XrdHdfsBufPool.hh"
+#include "XrdHdfsCache.hh"
+#include "XrdHdfsHandleCache.hh"
+#include "XrdHdfsLatency.hh"
+#include "XrdHdfsNamespace.hh"
+#include "XrdHdfsTrace.hh"
+#include "XrdHdfsWorkers.hh"
 
 /******************************************************************************/
 /*                               d e f i n e s                                */
@@ -34,6 +47,48 @@ const char *XrdHdfsConfigCVSID = "$Id$";
 
 #define TS_Xeq(x,m)    if (!strcmp(x,var)) return m(Config);
 
+/******************************************************************************/
+/*                        S t a t s L o g M a i n                             */
+/******************************************************************************/
+
+namespace
+{
+   struct StatsLogArgs
+   {
+      XrdHdfsSys *m_sys;
+      int         m_interval;
+   };
+
+   // Log the plugin's statistics every m_interval seconds, for good.
+   void *StatsLogMain(void *arg)
+   {
+      StatsLogArgs *args = static_cast<StatsLogArgs *>(arg);
+      while (true)
+         {XrdSysTimer::Snooze(args->m_interval);
+          args->m_sys->LogStats();
+         }
+      return NULL;
+   }
+
+   struct SweepArgs
+   {
+      XrdHdfsSys *m_sys;
+      int         m_interval;
+   };
+
+   // Expire cached handles and idle connections every m_interval seconds,
+   // for good; otherwise only the next open would.
+   void *SweepMain(void *arg)
+   {
+      SweepArgs *args = static_cast<SweepArgs *>(arg);
+      while (true)
+         {XrdSysTimer::Snooze(args->m_interval);
+          args->m_sys->Sweep();
+         }
+      return NULL;
+   }
+}
+
 /******************************************************************************/
 /*                             C o n f i g u r e                              */
 /******************************************************************************/
@@ -58,6 +113,126 @@ int XrdHdfsSys::Configure(const char *cfn)
 //
    if ((NoGo = ConfigProc(cfn))) return NoGo;
 
+// Load the HDFS client library.
+//
+   {XrdHdfs::Backend::Kind kind = m_backend_native ? XrdHdfs::Backend::Native
+                                                   : XrdHdfs::Backend::Libhdfs;
+    std::string library = m_backend_lib.empty() ? XrdHdfs::DefaultBackendLibrary(kind)
+                                                : m_backend_lib;
+    std::string detail;
+    int rc = XrdHdfs::LoadBackend(kind, library, detail);
+    const char *fallback = XrdHdfs::FallbackBackendLibrary(kind);
+    if (rc == ENOENT && m_backend_lib.empty() && fallback)
+       {library = fallback;
+        rc = XrdHdfs::LoadBackend(kind, library, detail);
+       }
+    if (rc)
+       {eDest->Emsg("Config", rc, "load HDFS client library", detail.c_str()); return 1;}
+    eDest->Say("Config using HDFS client library ", library.c_str());
+   }
+
+// Set up the negative lookup cache used for cmsd existence probes.
+//
+   if (m_negcache_ttl > 0)
+      m_neg_cache = new XrdHdfs::NegativeCache(m_negcache_ttl, m_negcache_size);
+
+// Set up the shared directory listing cache.
+//
+   if (m_dircache_ttl > 0)
+      {if (m_dirlist_paged)
+          eDest->Say("Config warning: dircache is not used with paged directory listings.");
+          else m_dir_cache = new XrdHdfs::DirCache(m_dircache_ttl, m_dircache_size,
+                                                   m_dircache_shared);
+      }
+
+// Set up the stat cache filled by directory-scoped prefetch.
+//
+   if (m_statcache_ttl > 0)
+      m_stat_cache = new XrdHdfs::StatCache(m_statcache_ttl, m_statcache_size,
+                                            m_statcache_burst);
+
+// Set up the namespaces and their per-user connection pools.
+//
+   m_ns_map = new XrdHdfs::NamespaceMap(m_connpool_peruser, m_connpool_maxusers,
+                                        m_connpool_idle);
+   for (size_t idx = 0; idx < m_ns_routes.size(); idx++)
+       m_ns_map->Add(m_ns_routes[idx].first, m_ns_routes[idx].second);
+
+// Set up the pool of read buffers.
+//
+   m_buf_pool = new XrdHdfs::BufferPool(m_bufpool_limit,
+                    static_cast<XrdHdfs::BufferPool::HugePages>(m_bufpool_huge));
+
+// Set up the cache of read-only file handles.
+//
+   if (m_handlecache_ttl > 0)
+      m_handle_cache = new XrdHdfs::HandleCache(m_handlecache_ttl, m_handlecache_size);
+
+// Close expired handles and idle connections even when no client comes by.
+//
+   if (m_handle_cache || m_connpool_idle > 0)
+      {SweepArgs *args = new SweepArgs;
+       args->m_sys = this;
+       args->m_interval = 60;
+       if (m_handle_cache)
+          args->m_interval = std::min(args->m_interval, std::max(m_handlecache_ttl/2, 1));
+       if (m_connpool_idle > 0)
+          args->m_interval = std::min(args->m_interval, std::max(m_connpool_idle/4, 1));
+       pthread_t tid;
+       if (XrdSysThread::Run(&tid, SweepMain, static_cast<void *>(args), 0, "HDFS sweep"))
+          {eDest->Emsg("Config", errno, "start the sweep thread"); return 1;}
+      }
+
+// Start the JNI worker threads, if libhdfs calls are to be made on them.
+//
+   if (m_jni_workers > 0 && m_backend_native)
+      eDest->Say("Config ignoring jniworkers; the native backend does not use a JVM.");
+   else if (m_jni_workers > 0)
+      {XrdHdfs::JniWorkers *workers = new XrdHdfs::JniWorkers(m_jni_workers);
+       int rc = workers->Start();
+       if (rc)
+          {eDest->Emsg("Config", rc, "start JNI worker threads"); return 1;}
+       XrdHdfs::g_jni_workers = workers;
+      }
+
+// Set up admission control if any class of calls is limited.
+//
+   for (int idx = 0; idx < XrdHdfs::OpClassCount; idx++)
+       if (m_sched_limits[idx])
+          {XrdHdfs::g_scheduler = new XrdHdfs::Scheduler(m_sched_limits);
+           break;
+          }
+
+// Time operations, and log a summary periodically and slow operations if
+// asked to.
+//
+   XrdHdfs::g_latency_enabled = m_latency_enabled;
+   if (m_slowlog_threshold > 0)
+      XrdHdfs::EnableSlowLog(*eDest, m_slowlog_threshold * 1000ULL);
+
+// Account I/O by user and path prefix; this is fed by tracing operations.
+//
+   if (m_ioaccount || !m_io_prefixes.empty())
+      {XrdHdfs::g_accounting = new XrdHdfs::IoAccounting(m_io_prefixes, m_ioaccount_maxusers);
+       XrdHdfs::g_op_tracing = true;
+      }
+   if (m_statslog_interval > 0)
+      {StatsLogArgs *args = new StatsLogArgs;
+       args->m_sys = this;
+       args->m_interval = m_statslog_interval;
+       pthread_t tid;
+       if (XrdSysThread::Run(&tid, StatsLogMain, static_cast<void *>(args), 0, "HDFS stats log"))
+          {eDest->Emsg("Config", errno, "start the statistics log thread"); return 1;}
+      }
+
+// Log traced events from a thread of their own.
+//
+   if (XrdHdfs::OssTrace.What)
+      {int rc = XrdHdfs::StartTrace(*eDest, m_trace_rate);
+       if (rc)
+          {eDest->Emsg("Config", rc, "start the trace thread"); return 1;}
+      }
+
 // Allocate an Xroot proxy object (only one needed here)
 //
    return 0;
@@ -124,6 +299,25 @@ int XrdHdfsSys::ConfigXeq(char *var, XrdOucStream &Config)
    //
 
    TS_Xeq("namelib",       xnml);
+   TS_Xeq("negcache",      xnegc);
+   TS_Xeq("dirlist",       xdirl);
+   TS_Xeq("dircache",      xdirc);
+   TS_Xeq("statprefetch",  xstpf);
+   TS_Xeq("connpool",      xcpool);
+   TS_Xeq("jniworkers",    xjniw);
+   TS_Xeq("sched",         xsched);
+   TS_Xeq("bufpool",       xbufp);
+   TS_Xeq("handlecache",   xhndc);
+   TS_Xeq("lazyopen",      xlazy);
+   TS_Xeq("namespace",     xnspc);
+   TS_Xeq("backend",       xbknd);
+   TS_Xeq("latency",       xlatn);
+   TS_Xeq("statslog",      xstlg);
+   TS_Xeq("slowlog",       xslow);
+   TS_Xeq("ioaccount",     xioac);
+   TS_Xeq("ioprefix",      xiopf);
+   TS_Xeq("trace",         xtrace);
+   TS_Xeq("warmup",        xwarm);
 
    // No match found, complain.
    //
@@ -198,3 +392,847 @@ int XrdHdfsSys::xnml(XrdOucStream &Config)
    return 0;
 }
 
+
+/******************************************************************************/
+/*                                 x n e g c                                  */
+/******************************************************************************/
+
+/* Function: xnegc
+
+   Purpose:  To parse the directive: negcache {off | [ttl <sec>] [size <num>]}
+
+             off       disables the negative lookup cache (the default).
+             <sec>     how long a missing path is remembered (default 5s
+                       once enabled).
+             <num>     maximum number of missing paths remembered
+                       (default 65536).
+
+   Notes:    The cache only answers stat requests without a client identity,
+             i.e., existence probes from the cmsd.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xnegc(XrdOucStream &Config)
+{
+    char *val;
+    int ttl = m_negcache_ttl ? m_negcache_ttl : 5, size = m_negcache_size;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "negcache parameters not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_negcache_ttl = 0; return 0;}
+
+    while (val && val[0])
+       {if (!strcmp(val, "ttl"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "negcache ttl value not specified"); return 1;}
+            if (XrdOuca2x::a2tm(*eDest, "negcache ttl", val, &ttl, 1)) return 1;
+           }
+        else if (!strcmp(val, "size"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "negcache size value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "negcache size", val, &size, 1)) return 1;
+           }
+        else {eDest->Emsg("Config", "invalid negcache option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_negcache_ttl = ttl;
+    m_negcache_size = size;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x d i r l                                  */
+/******************************************************************************/
+
+/* Function: xdirl
+
+   Purpose:  To parse the directive: dirlist {full | paged}
+
+             full      fetch the whole listing with hdfsListDirectory at
+                       opendir time (the default).
+             paged     stream the listing from the namenode a page at a time
+                       so memory use does not grow with the directory size.
+                       Falls back to full listings if no JVM is available.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xdirl(XrdOucStream &Config)
+{
+    char *val;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "dirlist mode not specified"); return 1;}
+
+    if (!strcmp(val, "full")) m_dirlist_paged = false;
+       else if (!strcmp(val, "paged")) m_dirlist_paged = true;
+       else {eDest->Emsg("Config", "invalid dirlist mode", val); return 1;}
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x d i r c                                  */
+/******************************************************************************/
+
+/* Function: xdirc
+
+   Purpose:  To parse the directive:
+
+             dircache {off | [ttl <sec>] [size <num>] [shared]}
+
+             off       disables the directory listing cache (the default).
+             <sec>     how long a listing may be reused.
+             <num>     maximum number of directory entries held across all
+                       cached listings (default 262144).
+             shared    share listings between all users.  Without this,
+                       listings are cached per user, as HDFS permission
+                       checks depend on who is listing.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xdirc(XrdOucStream &Config)
+{
+    char *val;
+    int ttl = m_dircache_ttl ? m_dircache_ttl : 10, size = m_dircache_size;
+    bool shared = false;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "dircache parameters not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_dircache_ttl = 0; return 0;}
+
+    while (val && val[0])
+       {if (!strcmp(val, "ttl"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "dircache ttl value not specified"); return 1;}
+            if (XrdOuca2x::a2tm(*eDest, "dircache ttl", val, &ttl, 1)) return 1;
+           }
+        else if (!strcmp(val, "size"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "dircache size value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "dircache size", val, &size, 1)) return 1;
+           }
+        else if (!strcmp(val, "shared")) shared = true;
+        else {eDest->Emsg("Config", "invalid dircache option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_dircache_ttl = ttl;
+    m_dircache_size = size;
+    m_dircache_shared = shared;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x s t p f                                  */
+/******************************************************************************/
+
+/* Function: xstpf
+
+   Purpose:  To parse the directive:
+
+             statprefetch {off | [burst <n>] [ttl <sec>] [size <num>]}
+
+             off       disables stat prefetching (the default).
+             <n>       number of stats under one directory within a second
+                       which triggers listing that directory (default 4).
+             <sec>     how long prefetched stat data may be used (default 5s).
+             <num>     maximum number of stat results held (default 262144).
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xstpf(XrdOucStream &Config)
+{
+    char *val;
+    int ttl = m_statcache_ttl ? m_statcache_ttl : 5, size = m_statcache_size;
+    int burst = m_statcache_burst;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "statprefetch parameters not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_statcache_ttl = 0; return 0;}
+
+    while (val && val[0])
+       {if (!strcmp(val, "burst"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "statprefetch burst value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "statprefetch burst", val, &burst, 1)) return 1;
+           }
+        else if (!strcmp(val, "ttl"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "statprefetch ttl value not specified"); return 1;}
+            if (XrdOuca2x::a2tm(*eDest, "statprefetch ttl", val, &ttl, 1)) return 1;
+           }
+        else if (!strcmp(val, "size"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "statprefetch size value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "statprefetch size", val, &size, 1)) return 1;
+           }
+        else {eDest->Emsg("Config", "invalid statprefetch option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_statcache_ttl = ttl;
+    m_statcache_size = size;
+    m_statcache_burst = burst;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                x c p o o l                                 */
+/******************************************************************************/
+
+/* Function: xcpool
+
+   Purpose:  To parse the directive:
+
+             connpool [peruser <n>] [maxusers <num>] [idle <sec>]
+
+             <n>       maximum number of HDFS connections opened for a single
+                       user (default 4).  Additional connections are only
+                       opened while all of the user's existing ones are busy.
+             <num>     number of users to keep connections for (default 1024);
+                       beyond this, idle users are closed oldest first.
+             <sec>     close a user's connections once unused for this long
+                       (default 10m); 0 keeps them until evicted by maxusers.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xcpool(XrdOucStream &Config)
+{
+    char *val;
+    int peruser = m_connpool_peruser, maxusers = m_connpool_maxusers;
+    int idle = m_connpool_idle;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "connpool parameters not specified"); return 1;}
+
+    while (val && val[0])
+       {if (!strcmp(val, "peruser"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "connpool peruser value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "connpool peruser", val, &peruser, 1, 256)) return 1;
+           }
+        else if (!strcmp(val, "maxusers"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "connpool maxusers value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "connpool maxusers", val, &maxusers, 1)) return 1;
+           }
+        else if (!strcmp(val, "idle"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "connpool idle value not specified"); return 1;}
+            if (XrdOuca2x::a2tm(*eDest, "connpool idle", val, &idle, 0)) return 1;
+           }
+        else {eDest->Emsg("Config", "invalid connpool option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_connpool_peruser = peruser;
+    m_connpool_maxusers = maxusers;
+    m_connpool_idle = idle;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x j n i w                                  */
+/******************************************************************************/
+
+/* Function: xjniw
+
+   Purpose:  To parse the directive:
+
+             jniworkers {off | <n>}
+
+             off       make libhdfs calls on the calling thread (the default).
+             <n>       make all libhdfs calls on a pool of <n> threads instead.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xjniw(XrdOucStream &Config)
+{
+    char *val;
+    int workers;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "jniworkers value not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_jni_workers = 0; return 0;}
+
+    if (XrdOuca2x::a2i(*eDest, "jniworkers", val, &workers, 1, 4096)) return 1;
+    m_jni_workers = workers;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                x s c h e d                                 */
+/******************************************************************************/
+
+/* Function: xsched
+
+   Purpose:  To parse the directive:
+
+             sched {off | <class> <n> [<class> <n> ...]}
+
+             off       do not limit libhdfs calls (the default).
+             <class>   one of cmsd (existence checks from the cmsd), meta
+                       (namespace operations for clients), read, write or
+                       cksum (reads made to compute checksums).
+             <n>       maximum number of calls of that class to run at once;
+                       0 for no limit.  Waiting calls are admitted
+                       round-robin across users.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xsched(XrdOucStream &Config)
+{
+    char *val;
+    unsigned limits[XrdHdfs::OpClassCount];
+    int cls, limit;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "sched parameters not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {memset(m_sched_limits, 0, sizeof(m_sched_limits)); return 0;}
+
+    memcpy(limits, m_sched_limits, sizeof(limits));
+    while (val && val[0])
+       {for (cls = 0; cls < XrdHdfs::OpClassCount; cls++)
+            if (!strcmp(val, XrdHdfs::OpClassName(static_cast<XrdHdfs::OpClass>(cls)))) break;
+        if (cls == XrdHdfs::OpClassCount)
+           {eDest->Emsg("Config", "invalid sched class", val); return 1;}
+        if (!(val = Config.GetWord()))
+           {eDest->Emsg("Config", "sched limit not specified"); return 1;}
+        if (XrdOuca2x::a2i(*eDest, "sched limit", val, &limit, 0)) return 1;
+        limits[cls] = limit;
+        val = Config.GetWord();
+       }
+
+    memcpy(m_sched_limits, limits, sizeof(limits));
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x b u f p                                  */
+/******************************************************************************/
+
+/* Function: xbufp
+
+   Purpose:  To parse the directive:
+
+             bufpool [bufsize <bytes>] [limit <bytes>]
+                     [hugepages {off | transparent | explicit}]
+
+             bufsize   size of the read buffer given to each file opened
+                       for reading (default 32k); rounded up to a power of 2.
+             limit     total memory for read buffers (default 1g).  Past it,
+                       files get smaller buffers, or none at all.
+             hugepages back buffers of 2m or more with transparent huge
+                       pages, or with reserved ones (MAP_HUGETLB), falling
+                       back to normal pages.  The default is off.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xbufp(XrdOucStream &Config)
+{
+    char *val;
+    long long bufsize = m_bufpool_size, limit = m_bufpool_limit;
+    int huge = m_bufpool_huge;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "bufpool parameters not specified"); return 1;}
+
+    while (val && val[0])
+       {if (!strcmp(val, "bufsize"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "bufpool bufsize value not specified"); return 1;}
+            if (XrdOuca2x::a2sz(*eDest, "bufpool bufsize", val, &bufsize,
+                                XrdHdfs::BufferPool::m_min_size, 1024*1024*1024)) return 1;
+           }
+        else if (!strcmp(val, "limit"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "bufpool limit value not specified"); return 1;}
+            if (XrdOuca2x::a2sz(*eDest, "bufpool limit", val, &limit, 0)) return 1;
+           }
+        else if (!strcmp(val, "hugepages"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "bufpool hugepages value not specified"); return 1;}
+            if (!strcmp(val, "off")) huge = XrdHdfs::BufferPool::HugePagesOff;
+            else if (!strcmp(val, "transparent")) huge = XrdHdfs::BufferPool::HugePagesTransparent;
+            else if (!strcmp(val, "explicit")) huge = XrdHdfs::BufferPool::HugePagesExplicit;
+            else {eDest->Emsg("Config", "invalid bufpool hugepages value", val); return 1;}
+           }
+        else {eDest->Emsg("Config", "invalid bufpool option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_bufpool_size = bufsize;
+    m_bufpool_limit = limit;
+    m_bufpool_huge = huge;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x h n d c                                  */
+/******************************************************************************/
+
+/* Function: xhndc
+
+   Purpose:  To parse the directive:
+
+             handlecache {off | [ttl <sec>] [size <num>]}
+
+             off       close files as soon as they are closed (the default).
+             ttl       seconds a file opened for reading is kept open after
+                       close, for reuse by a later open of the same file by
+                       the same user (default 30 once enabled).
+             size      maximum number of handles kept open (default 1024).
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xhndc(XrdOucStream &Config)
+{
+    char *val;
+    int ttl = m_handlecache_ttl ? m_handlecache_ttl : 30;
+    int size = m_handlecache_size;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "handlecache parameters not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_handlecache_ttl = 0; return 0;}
+
+    while (val && val[0])
+       {if (!strcmp(val, "ttl"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "handlecache ttl value not specified"); return 1;}
+            if (XrdOuca2x::a2tm(*eDest, "handlecache ttl", val, &ttl, 1)) return 1;
+           }
+        else if (!strcmp(val, "size"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "handlecache size value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "handlecache size", val, &size, 1)) return 1;
+           }
+        else {eDest->Emsg("Config", "invalid handlecache option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_handlecache_ttl = ttl;
+    m_handlecache_size = size;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x l a z y                                  */
+/******************************************************************************/
+
+/* Function: xlazy
+
+   Purpose:  To parse the directive: lazyopen {on | off}
+
+             on        opens for reading only check that the file exists;
+                       the file is opened, and its read buffer allocated, on
+                       the first read.
+             off       open files when they are opened (the default).
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xlazy(XrdOucStream &Config)
+{
+    char *val;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "lazyopen mode not specified"); return 1;}
+
+    if (!strcmp(val, "on")) m_lazy_open = true;
+       else if (!strcmp(val, "off")) m_lazy_open = false;
+       else {eDest->Emsg("Config", "invalid lazyopen mode", val); return 1;}
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x n s p c                                  */
+/******************************************************************************/
+
+/* Function: xnspc
+
+   Purpose:  To parse the directive: namespace <prefix> <namenode>
+
+             <prefix>   physical path prefix served by the namespace.
+             <namenode> namenode URI for it, e.g. hdfs://nn2.example.com:8020.
+
+             May be repeated; each path goes to the namespace with the
+             longest matching prefix, and unmatched paths to the default
+             filesystem of the Hadoop configuration.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xnspc(XrdOucStream &Config)
+{
+    char *val;
+    std::string prefix;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "namespace prefix not specified"); return 1;}
+    if (val[0] != '/')
+       {eDest->Emsg("Config", "namespace prefix is not absolute", val); return 1;}
+    prefix = val;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "namespace namenode not specified for", prefix.c_str());
+        return 1;
+       }
+
+    m_ns_routes.push_back(std::make_pair(prefix, std::string(val)));
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x b k n d                                  */
+/******************************************************************************/
+
+/* Function: xbknd
+
+   Purpose:  To parse the directive: backend {libhdfs | native} [<library>]
+
+             libhdfs   use Hadoop's libhdfs, which runs an embedded JVM (the
+                       default).
+             native    use a JVM-free client library implementing the libhdfs
+                       API, such as libhdfs3.
+             <library> the client library to load; defaults to the libhdfs
+                       the plugin was built with, or libhdfs3.so.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xbknd(XrdOucStream &Config)
+{
+    char *val;
+    bool native;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "backend not specified"); return 1;}
+
+    if (!strcmp(val, "libhdfs")) native = false;
+       else if (!strcmp(val, "native")) native = true;
+       else {eDest->Emsg("Config", "invalid backend", val); return 1;}
+
+    m_backend_native = native;
+    m_backend_lib = ((val = Config.GetWord()) && val[0]) ? val : "";
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x l a t n                                  */
+/******************************************************************************/
+
+/* Function: xlatn
+
+   Purpose:  To parse the directive: latency {on | off}
+
+             on        keep latency histograms of each operation and each
+                       libhdfs call, reported by getStats (the default).
+             off       do not time operations.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xlatn(XrdOucStream &Config)
+{
+    char *val;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "latency mode not specified"); return 1;}
+
+    if (!strcmp(val, "on")) m_latency_enabled = true;
+       else if (!strcmp(val, "off")) m_latency_enabled = false;
+       else {eDest->Emsg("Config", "invalid latency mode", val); return 1;}
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x s t l g                                  */
+/******************************************************************************/
+
+/* Function: xstlg
+
+   Purpose:  To parse the directive: statslog {off | <interval>}
+
+             off        do not log statistics (the default).
+             <interval> how often to log a summary of operation latencies.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xstlg(XrdOucStream &Config)
+{
+    char *val;
+    int interval;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "statslog interval not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_statslog_interval = 0; return 0;}
+
+    if (XrdOuca2x::a2tm(*eDest, "statslog interval", val, &interval, 1)) return 1;
+    m_statslog_interval = interval;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x s l o w                                  */
+/******************************************************************************/
+
+/* Function: xslow
+
+   Purpose:  To parse the directive: slowlog {off | <msec>}
+
+             off        do not log slow operations (the default).
+             <msec>     log each operation taking at least this many
+                        milliseconds, with where its time went.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xslow(XrdOucStream &Config)
+{
+    char *val;
+    int threshold;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "slowlog threshold not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_slowlog_threshold = 0; return 0;}
+
+    if (XrdOuca2x::a2i(*eDest, "slowlog threshold", val, &threshold, 1)) return 1;
+    m_slowlog_threshold = threshold;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x i o a c                                  */
+/******************************************************************************/
+
+/* Function: xioac
+
+   Purpose:  To parse the directive:
+
+             ioaccount {off | on | [maxusers <num>] [top <n>]}
+
+             off       disables I/O accounting (the default, unless ioprefix
+                       is given).
+             on        account operations, bytes and time in HDFS by user.
+             <num>     users counted separately (default 1024); the rest are
+                       counted together.
+             <n>       users, the busiest first, reported by getStats
+                       (default 20); the statistics log lists them all.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xioac(XrdOucStream &Config)
+{
+    char *val;
+    int maxusers = m_ioaccount_maxusers, top = m_ioaccount_top;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "ioaccount parameters not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_ioaccount = false; return 0;}
+    if (!strcmp(val, "on")) val = Config.GetWord();
+
+    while (val && val[0])
+       {if (!strcmp(val, "maxusers"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "ioaccount maxusers value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "ioaccount maxusers", val, &maxusers, 1)) return 1;
+           }
+        else if (!strcmp(val, "top"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "ioaccount top value not specified"); return 1;}
+            if (XrdOuca2x::a2i(*eDest, "ioaccount top", val, &top, 0)) return 1;
+           }
+        else {eDest->Emsg("Config", "invalid ioaccount option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_ioaccount = true;
+    m_ioaccount_maxusers = maxusers;
+    m_ioaccount_top = top;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x i o p f                                  */
+/******************************************************************************/
+
+/* Function: xiopf
+
+   Purpose:  To parse the directive: ioprefix <prefix>
+
+             <prefix>  a physical path prefix whose I/O is accounted apart;
+                       the directive may be repeated.  Turns on I/O
+                       accounting.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xiopf(XrdOucStream &Config)
+{
+    char *val;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "ioprefix prefix not specified"); return 1;}
+    if (val[0] != '/')
+       {eDest->Emsg("Config", "ioprefix prefix is not absolute", val); return 1;}
+
+    m_io_prefixes.push_back(val);
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                x t r a c e                                 */
+/******************************************************************************/
+
+/* Function: xtrace
+
+   Purpose:  To parse the directive:
+
+             trace [ratelimit <n>] {off | all | [-]<event> [[-]<event> ...]}
+
+             <n>       most messages logged a second (default 100; 0 for no
+                       limit).
+             off       traces nothing (the default).
+             all       traces every event.
+             <event>   open, n2n, cksum or stats; a leading '-' stops tracing
+                       the event.
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xtrace(XrdOucStream &Config)
+{
+    int trval = XrdHdfs::OssTrace.What, rate = m_trace_rate;
+
+    if (XrdHdfs::ParseTrace(*eDest, Config, trval, rate)) return 1;
+
+    XrdHdfs::OssTrace.What = trval;
+    m_trace_rate = rate;
+    return 0;
+}
+
+
+/******************************************************************************/
+/*                                 x w a r m                                  */
+/******************************************************************************/
+
+/* Function: xwarm
+
+   Purpose:  To parse the directive:
+
+             warmup {off | [users <user>[,<user>...]] [file <path>]
+                           [marker <mpath>] [hold <sec>]}
+
+             off       starts with nothing warmed up (the default).
+             <user>    users to open connections for in every namespace,
+                       besides the cmsd's.
+             <path>    a physical path of a file to read a little of.
+             <mpath>   the local file through which the data server tells
+                       the cmsd it is ready (default .hdfs_warm in the
+                       admin path).
+             <sec>     longest the cmsd's probes wait for the warm-up
+                       (default 60s).
+
+  Output: 0 upon success or !0 upon failure.
+*/
+
+int XrdHdfsSys::xwarm(XrdOucStream &Config)
+{
+    char *val;
+    int hold = m_warmup_hold;
+    std::vector<std::string> users;
+    std::string file = m_warmup_file;
+    std::string marker = m_warm_marker;
+
+    if (!(val = Config.GetWord()) || !val[0])
+       {eDest->Emsg("Config", "warmup parameters not specified"); return 1;}
+
+    if (!strcmp(val, "off"))
+       {m_warmup = false; return 0;}
+
+    while (val && val[0])
+       {if (!strcmp(val, "users"))
+           {if (!(val = Config.GetWord()) || !val[0])
+               {eDest->Emsg("Config", "warmup users not specified"); return 1;}
+            std::string list = val;
+            for (size_t pos = 0, end; pos <= list.size(); pos = end + 1)
+                {if ((end = list.find(',', pos)) == std::string::npos) end = list.size();
+                 if (end > pos) users.push_back(list.substr(pos, end - pos));
+                }
+           }
+        else if (!strcmp(val, "file"))
+           {if (!(val = Config.GetWord()) || !val[0])
+               {eDest->Emsg("Config", "warmup file not specified"); return 1;}
+            if (val[0] != '/')
+               {eDest->Emsg("Config", "warmup file is not absolute", val); return 1;}
+            file = val;
+           }
+        else if (!strcmp(val, "marker"))
+           {if (!(val = Config.GetWord()) || !val[0])
+               {eDest->Emsg("Config", "warmup marker not specified"); return 1;}
+            if (val[0] != '/')
+               {eDest->Emsg("Config", "warmup marker is not absolute", val); return 1;}
+            marker = val;
+           }
+        else if (!strcmp(val, "hold"))
+           {if (!(val = Config.GetWord()))
+               {eDest->Emsg("Config", "warmup hold value not specified"); return 1;}
+            if (XrdOuca2x::a2tm(*eDest, "warmup hold", val, &hold, 0)) return 1;
+           }
+        else {eDest->Emsg("Config", "invalid warmup option", val); return 1;}
+        val = Config.GetWord();
+       }
+
+    m_warmup = true;
+    if (!users.empty()) m_warmup_users = users;
+    m_warmup_file = file;
+    m_warm_marker = marker;
+    m_warmup_hold = hold;
+    return 0;
+}
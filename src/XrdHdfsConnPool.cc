@@ -0,0 +1,264 @@
+
+#include "XrdHdfsConnPool.hh"
+
+#include <errno.h>
+
+#include <algorithm>
+#include <functional>
+
+#include "XrdHdfsCache.hh"
+#include "XrdHdfsCalls.hh"
+
+using namespace XrdHdfs;
+
+
+ConnectionPool::ConnectionPool(const std::string &namenode, unsigned per_user,
+                               size_t max_users, unsigned idle_secs)
+    : m_namenode(namenode),
+      m_per_user(per_user ? per_user : 1),
+      m_max_users(max_users ? max_users : 1),
+      m_idle_ms(static_cast<long long>(idle_secs)*1000),
+      m_users(0),
+      m_connections(0),
+      m_evictions(0),
+      m_next_sweep(0),
+      m_last_sweep(0),
+      m_sweeping(false)
+{
+}
+
+
+ConnectionPool::Conn *
+ConnectionPool::LeastLoaded(const UserConns &conns)
+{
+    Conn *best = NULL;
+    unsigned best_active = 0;
+    for (std::vector<Conn *>::const_iterator iter = conns.m_conns.begin();
+         iter != conns.m_conns.end();
+         iter++)
+    {
+        unsigned active = (*iter)->m_active;
+        if (!best || (active < best_active))
+        {
+            best = *iter;
+            best_active = active;
+        }
+    }
+    return best;
+}
+
+
+// True if none of the user's connections is in use or being opened;
+// `last_used` is set to the last time any of them was.
+bool
+ConnectionPool::Idle(const UserConns &conns, long long &last_used)
+{
+    if (conns.m_pending) {return false;}
+    last_used = 0;
+    for (std::vector<Conn *>::const_iterator iter = conns.m_conns.begin();
+         iter != conns.m_conns.end();
+         iter++)
+    {
+        if ((*iter)->m_active) {return false;}
+        last_used = std::max(last_used, (*iter)->m_last_used.load());
+    }
+    return true;
+}
+
+
+ConnectionPool::ConnShard &
+ConnectionPool::ShardFor(hdfsFS fs)
+{
+    return m_conn_shards[std::hash<hdfsFS>()(fs) % m_shard_count];
+}
+
+
+hdfsFS
+ConnectionPool::Acquire(const std::string &user)
+{
+    MaybeSweep();
+
+    long long now = MonotonicMillis();
+    UserShard &shard = m_user_shards[std::hash<std::string>()(user) % m_shard_count];
+
+    shard.m_cond.Lock();
+    std::unordered_map<std::string, UserConns>::iterator iter = shard.m_users.find(user);
+    if (iter == shard.m_users.end())
+    {
+        iter = shard.m_users.insert(std::make_pair(user, UserConns())).first;
+        m_users++;
+    }
+    UserConns &conns = iter->second;
+
+    // Share an idle connection, or the least-loaded one once the user has all
+    // the connections they are allowed.  The very first callers for a user
+    // wait for the connection being opened rather than each opening one; more
+    // are opened once that one is busy.
+    Conn *best;
+    while (true)
+    {
+        best = LeastLoaded(conns);
+        if (best && (!best->m_active || (conns.m_conns.size() + conns.m_pending >= m_per_user)))
+        {
+            best->m_active++;
+            best->m_last_used = now;
+            shard.m_cond.UnLock();
+            return best->m_fs;
+        }
+        if (best || !conns.m_pending) {break;}
+        shard.m_cond.Wait();
+    }
+    conns.m_pending++;
+    shard.m_cond.UnLock();
+
+    // Opening a FileSystem instance can take a while; do not block other
+    // users of this shard meanwhile.
+    errno = 0;
+    hdfsFS fs = Hdfs::ConnectAsUserNewInstance(m_namenode.c_str(), 0, user.c_str());
+    int saved_errno = errno;
+
+    shard.m_cond.Lock();
+    conns.m_pending--;
+    if (fs)
+    {
+        Conn *conn = new Conn(fs);
+        conn->m_active = 1;
+        conn->m_last_used = now;
+        conns.m_conns.push_back(conn);
+        m_connections++;
+
+        ConnShard &conn_shard = ShardFor(fs);
+        XrdSysMutexHelper lock(conn_shard.m_mutex);
+        conn_shard.m_conns[fs] = conn;
+    }
+    else if ((best = LeastLoaded(conns)))
+    {
+        // Could not open another one; fall back to sharing what we have.
+        best->m_active++;
+        best->m_last_used = now;
+        fs = best->m_fs;
+    }
+    shard.m_cond.Broadcast();
+    shard.m_cond.UnLock();
+
+    if (!fs) {errno = saved_errno ? saved_errno : EIO;}
+    return fs;
+}
+
+
+bool
+ConnectionPool::Release(hdfsFS fs)
+{
+    if (!fs) {return false;}
+
+    ConnShard &conn_shard = ShardFor(fs);
+    XrdSysMutexHelper lock(conn_shard.m_mutex);
+    std::unordered_map<hdfsFS, Conn *>::iterator iter = conn_shard.m_conns.find(fs);
+    if (iter == conn_shard.m_conns.end()) {return false;}
+
+    iter->second->m_last_used = MonotonicMillis();
+    iter->second->m_active--;
+    return true;
+}
+
+
+// Sweep for idle users every so often, or promptly (but at most every 100ms)
+// while over the user limit; only one thread sweeps at a time.
+void
+ConnectionPool::MaybeSweep()
+{
+    long long now = MonotonicMillis();
+    if ((now < m_next_sweep) &&
+        ((m_users <= m_max_users) || (now - m_last_sweep < 100))) {return;}
+    if (m_sweeping.exchange(true)) {return;}
+
+    Sweep(now);
+
+    m_last_sweep = now;
+    m_next_sweep = now + (m_idle_ms ? std::min(std::max(m_idle_ms/4, 1000LL), 60000LL) : 60000);
+    m_sweeping = false;
+}
+
+
+void
+ConnectionPool::Sweep(long long now)
+{
+    std::vector<hdfsFS> closing;
+    std::vector<std::pair<long long, std::string> > candidates;
+
+    for (unsigned idx = 0; idx < m_shard_count; idx++)
+    {
+        UserShard &shard = m_user_shards[idx];
+        XrdSysCondVarHelper lock(shard.m_cond);
+        UserMap::iterator iter = shard.m_users.begin();
+        while (iter != shard.m_users.end())
+        {
+            long long last_used;
+            if (!Idle(iter->second, last_used))
+            {
+                iter++;
+            }
+            else if (m_idle_ms && (now - last_used >= m_idle_ms))
+            {
+                iter = Evict(shard, iter, closing);
+            }
+            else
+            {
+                candidates.push_back(std::make_pair(last_used, iter->first));
+                iter++;
+            }
+        }
+    }
+
+    // Still over the limit: close the least recently used idle users.
+    if (m_users > m_max_users)
+    {
+        std::sort(candidates.begin(), candidates.end());
+        for (std::vector<std::pair<long long, std::string> >::const_iterator cand = candidates.begin();
+             (cand != candidates.end()) && (m_users > m_max_users);
+             cand++)
+        {
+            UserShard &shard = m_user_shards[std::hash<std::string>()(cand->second) % m_shard_count];
+            XrdSysCondVarHelper lock(shard.m_cond);
+            UserMap::iterator iter = shard.m_users.find(cand->second);
+            long long last_used;
+            if ((iter != shard.m_users.end()) && Idle(iter->second, last_used))
+            {
+                Evict(shard, iter, closing);
+            }
+        }
+    }
+
+    // Shutting down a FileSystem is a JNI call; do it without any locks held.
+    for (std::vector<hdfsFS>::const_iterator iter = closing.begin();
+         iter != closing.end();
+         iter++)
+    {
+        Hdfs::Disconnect(*iter);
+    }
+}
+
+
+// Drop an idle user; the caller holds the shard lock and must hdfsDisconnect
+// the connections left in `closing` after releasing it.
+ConnectionPool::UserMap::iterator
+ConnectionPool::Evict(UserShard &shard, UserMap::iterator iter, std::vector<hdfsFS> &closing)
+{
+    std::vector<Conn *> &conns = iter->second.m_conns;
+    for (std::vector<Conn *>::const_iterator conn = conns.begin();
+         conn != conns.end();
+         conn++)
+    {
+        ConnShard &conn_shard = ShardFor((*conn)->m_fs);
+        {
+            XrdSysMutexHelper lock(conn_shard.m_mutex);
+            conn_shard.m_conns.erase((*conn)->m_fs);
+        }
+        closing.push_back((*conn)->m_fs);
+        delete *conn;
+        m_connections--;
+    }
+    m_users--;
+    m_evictions++;
+    return shard.m_users.erase(iter);
+}
@@ -0,0 +1,132 @@
+
+/*
+ * Per-user pools of HDFS filesystem connections.
+ */
+
+#ifndef __XRDHDFS_CONNPOOL_H__
+#define __XRDHDFS_CONNPOOL_H__
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "hdfs.h"
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace XrdHdfs {
+
+/*
+ * A pool of hdfsFS connections, several per user identity.
+ *
+ * Each hdfsFS is a separate Java FileSystem object with its own DFS client,
+ * RPC queue and internal locks; with a single instance per user, all of a
+ * heavy user's traffic serializes behind that one client.  The pool hands out
+ * the least-loaded of a user's connections and opens another (up to
+ * `per_user`) only when all existing ones are busy.
+ *
+ * Lookups are spread over independently locked shards so that threads working
+ * for different users do not contend on a single global mutex.
+ *
+ * Every FileSystem instance holds JVM heap, threads and sockets, and a gateway
+ * may see thousands of distinct identities.  Connections are reference counted
+ * (each Acquire holds one until its Release), and a user's connections are
+ * closed once none is in use and they have been idle for `idle_secs` (if
+ * non-zero).  When
+ * more than `max_users` users are connected, the least recently used idle
+ * users are closed first.  Users with connections in use are never evicted,
+ * so `max_users` may be briefly exceeded.
+ */
+class ConnectionPool
+{
+public:
+    // Connections are made to `namenode`, as given to hdfsConnect ("default"
+    // for the filesystem named in the Hadoop configuration).
+    ConnectionPool(const std::string &namenode, unsigned per_user,
+                   size_t max_users, unsigned idle_secs);
+
+    // Return a connection acting as `user`, or NULL with errno set.  Every
+    // successful Acquire must be paired with a Release.
+    hdfsFS Acquire(const std::string &user);
+
+    // Returns false if `fs` is not one of this pool's connections.
+    bool Release(hdfsFS fs);
+
+    // Evict idle users if a sweep is due.  Acquire does this too; it is also
+    // called periodically, so a quiet server lets go of its connections.
+    void MaybeSweep();
+
+    size_t Users() const {return m_users;}
+    size_t Connections() const {return m_connections;}
+    unsigned long long Evictions() const {return m_evictions;}
+
+private:
+    ConnectionPool(ConnectionPool const &);
+    ConnectionPool & operator=(ConnectionPool const &);
+
+    struct Conn
+    {
+        explicit Conn(hdfsFS fs) : m_fs(fs), m_active(0), m_last_used(0) {}
+
+        hdfsFS m_fs;
+        std::atomic<unsigned> m_active;     // Callers currently holding m_fs.
+        std::atomic<long long> m_last_used; // Last Acquire or Release.
+    };
+
+    struct UserConns
+    {
+        UserConns() : m_pending(0) {}
+
+        std::vector<Conn *> m_conns;
+        unsigned m_pending; // Connections being opened right now.
+    };
+
+    typedef std::unordered_map<std::string, UserConns> UserMap;
+
+    // Connections of the users hashing to this shard.
+    struct UserShard
+    {
+        UserShard() : m_cond(0) {}
+
+        XrdSysCondVar m_cond;
+        UserMap m_users;
+    };
+
+    // Maps an hdfsFS back to its entry, so Release need not know the user.
+    struct ConnShard
+    {
+        XrdSysMutex m_mutex;
+        std::unordered_map<hdfsFS, Conn *> m_conns;
+    };
+
+    static const unsigned m_shard_count = 16;
+
+    static Conn *LeastLoaded(const UserConns &conns);
+    static bool Idle(const UserConns &conns, long long &last_used);
+    ConnShard &ShardFor(hdfsFS fs);
+
+    void Sweep(long long now);
+    UserMap::iterator Evict(UserShard &shard, UserMap::iterator iter,
+                            std::vector<hdfsFS> &closing);
+
+    const std::string m_namenode;
+    const unsigned m_per_user;
+    const size_t m_max_users;
+    const long long m_idle_ms;
+
+    UserShard m_user_shards[m_shard_count];
+    ConnShard m_conn_shards[m_shard_count];
+
+    std::atomic<size_t> m_users;
+    std::atomic<size_t> m_connections;
+    std::atomic<unsigned long long> m_evictions;
+
+    std::atomic<long long> m_next_sweep;
+    std::atomic<long long> m_last_sweep;
+    std::atomic<bool> m_sweeping;
+};
+
+}
+
+#endif
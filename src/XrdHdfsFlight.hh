@@ -0,0 +1,101 @@
+
+/*
+ * Request coalescing for the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_FLIGHT_H__
+#define __XRDHDFS_FLIGHT_H__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace XrdHdfs {
+
+/*
+ * Collapse identical concurrent lookups into one.
+ *
+ * When a popular file is released, many clients ask the namenode about the
+ * same path within a few milliseconds.  The first caller for a key performs
+ * the lookup; callers arriving while it is in flight wait for it and receive
+ * a copy of its result.  Nothing is remembered once the lookup completes, so
+ * this never returns stale data -- it only removes duplicate RPCs.
+ *
+ * Keys must include everything the result depends on, such as the identity
+ * the lookup is made as.
+ */
+template <typename Result>
+class SingleFlight
+{
+public:
+    SingleFlight() : m_calls(0), m_collapsed(0) {}
+
+    // Fill `result` by calling fn(result), unless an identical call for `key`
+    // is already running; in that case wait for it and copy its result.
+    template <typename Fn>
+    void Do(const std::string &key, Result &result, Fn fn)
+    {
+        m_calls++;
+
+        m_mutex.Lock();
+        typename CallMap::iterator iter = m_inflight.find(key);
+        if (iter != m_inflight.end())
+        {
+            std::shared_ptr<Call> call = iter->second;
+            m_mutex.UnLock();
+            m_collapsed++;
+
+            call->m_cond.Lock();
+            while (!call->m_done) {call->m_cond.Wait();}
+            result = call->m_result;
+            call->m_cond.UnLock();
+            return;
+        }
+        std::shared_ptr<Call> call = std::make_shared<Call>();
+        m_inflight[key] = call;
+        m_mutex.UnLock();
+
+        fn(result);
+
+        call->m_cond.Lock();
+        call->m_result = result;
+        call->m_done = true;
+        call->m_cond.Broadcast();
+        call->m_cond.UnLock();
+
+        XrdSysMutexHelper lock(m_mutex);
+        m_inflight.erase(key);
+    }
+
+    // Total calls to Do(), and how many of those shared another call's result.
+    unsigned long long Calls() const {return m_calls;}
+    unsigned long long Collapsed() const {return m_collapsed;}
+
+private:
+    SingleFlight(SingleFlight const &);
+    SingleFlight & operator=(SingleFlight const &);
+
+    struct Call
+    {
+        Call() : m_cond(0), m_done(false) {}
+
+        XrdSysCondVar m_cond;
+        bool m_done;
+        Result m_result;
+    };
+
+    typedef std::unordered_map<std::string, std::shared_ptr<Call> > CallMap;
+
+    XrdSysMutex m_mutex;
+    CallMap m_inflight;
+
+    std::atomic<unsigned long long> m_calls;
+    std::atomic<unsigned long long> m_collapsed;
+};
+
+}
+
+#endif
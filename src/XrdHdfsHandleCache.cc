@@ -0,0 +1,129 @@
+
+#include "XrdHdfsHandleCache.hh"
+
+#include "XrdHdfsCache.hh"
+
+using namespace XrdHdfs;
+
+
+HandleCache::HandleCache(unsigned ttl_secs, size_t max_entries)
+    : m_ttl_ms(ttl_secs*1000LL),
+      m_max_entries(max_entries),
+      m_size(0),
+      m_hits(0),
+      m_misses(0),
+      m_stale(0)
+{
+}
+
+
+// Drop the entry behind `index_iter`, handing its handle to the caller.
+// Called with m_mutex held.
+void
+HandleCache::Erase(PathIndex::iterator index_iter, std::vector<Handle> &released)
+{
+    released.push_back(index_iter->second->m_handle);
+    m_entries.erase(index_iter->second);
+    m_index.erase(index_iter);
+    m_size--;
+}
+
+
+// Drop expired entries, and the oldest ones while over the size limit.
+// Entries are ordered by insertion, so both are found at the tail.  Called
+// with m_mutex held.
+void
+HandleCache::Expire(long long now, std::vector<Handle> &released)
+{
+    while (!m_entries.empty() &&
+           ((m_entries.back().m_expiry <= now) || (m_size > m_max_entries)))
+    {
+        EntryList::iterator entry = --m_entries.end();
+        std::pair<PathIndex::iterator, PathIndex::iterator> range = m_index.equal_range(entry->m_path);
+        for (PathIndex::iterator iter = range.first; iter != range.second; ++iter)
+        {
+            if (iter->second == entry)
+            {
+                Erase(iter, released);
+                break;
+            }
+        }
+    }
+}
+
+
+bool
+HandleCache::Take(const std::string &path, const std::string &user,
+                  const struct stat &current, Handle &handle,
+                  std::vector<Handle> &released)
+{
+    XrdSysMutexHelper lock(m_mutex);
+    Expire(MonotonicMillis(), released);
+
+    std::pair<PathIndex::iterator, PathIndex::iterator> range = m_index.equal_range(path);
+    for (PathIndex::iterator iter = range.first; iter != range.second; ++iter)
+    {
+        const Entry &entry = *iter->second;
+        if (entry.m_user != user) {continue;}
+
+        // The file was replaced or appended to since this handle was opened;
+        // drop it, and have the caller open the file afresh.
+        if ((entry.m_handle.m_stat.st_mtime != current.st_mtime) ||
+            (entry.m_handle.m_stat.st_size != current.st_size))
+        {
+            Erase(iter, released);
+            m_stale++;
+            break;
+        }
+
+        handle = entry.m_handle;
+        m_entries.erase(iter->second);
+        m_index.erase(iter);
+        m_size--;
+        m_hits++;
+        return true;
+    }
+
+    m_misses++;
+    return false;
+}
+
+
+void
+HandleCache::Put(const std::string &path, const std::string &user,
+                 const Handle &handle, std::vector<Handle> &released)
+{
+    long long now = MonotonicMillis();
+    XrdSysMutexHelper lock(m_mutex);
+
+    Entry entry;
+    entry.m_path = path;
+    entry.m_user = user;
+    entry.m_handle = handle;
+    entry.m_expiry = now + m_ttl_ms;
+    m_entries.push_front(entry);
+    m_index.insert(PathIndex::value_type(path, m_entries.begin()));
+    m_size++;
+
+    Expire(now, released);
+}
+
+
+void
+HandleCache::Invalidate(const std::string &path, std::vector<Handle> &released)
+{
+    XrdSysMutexHelper lock(m_mutex);
+    std::pair<PathIndex::iterator, PathIndex::iterator> range = m_index.equal_range(path);
+    while (range.first != range.second)
+    {
+        Erase(range.first++, released);
+    }
+}
+
+
+void
+HandleCache::Sweep(std::vector<Handle> &released)
+{
+    XrdSysMutexHelper lock(m_mutex);
+    Expire(MonotonicMillis(), released);
+}
@@ -0,0 +1,105 @@
+
+/*
+ * A cache of recently closed read-only file handles.
+ */
+
+#ifndef __XRDHDFS_HANDLECACHE_H__
+#define __XRDHDFS_HANDLECACHE_H__
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "hdfs.h"
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace XrdHdfs {
+
+/*
+ * Keeps hdfsFile handles of files closed after reading open for a while, so
+ * that a reopen of the same file by the same user skips hdfsOpenFile and the
+ * block location lookup it makes at the namenode.
+ *
+ * Analysis jobs open and close the same input files over and over.  A cached
+ * handle is only reused if the file's current mtime and size match those it
+ * had when the handle was opened; the caller is expected to have just stat'd
+ * the file anyway.
+ *
+ * The cache never closes anything itself: handles it lets go of (expired,
+ * evicted, invalidated or stale) are passed back to the caller, which must
+ * close the file and release its connection outside the cache.
+ */
+class HandleCache
+{
+public:
+    struct Handle
+    {
+        hdfsFS m_fs;
+        hdfsFile m_fh;
+        struct stat m_stat; // Metadata of the file when it was opened.
+    };
+
+    HandleCache(unsigned ttl_secs, size_t max_entries);
+
+    // Look for a handle to `path` opened by `user` whose file still matches
+    // `current`.  On a hit, the handle is removed from the cache and returned
+    // in `handle`.  Handles to close are appended to `released`.
+    bool Take(const std::string &path, const std::string &user,
+              const struct stat &current, Handle &handle,
+              std::vector<Handle> &released);
+
+    // Keep `handle` to `path`, opened by `user`, for later reuse.
+    void Put(const std::string &path, const std::string &user,
+             const Handle &handle, std::vector<Handle> &released);
+
+    // Give up all handles to `path`; called after namespace mutations.
+    void Invalidate(const std::string &path, std::vector<Handle> &released);
+
+    // Give up expired handles.  Take and Put do this too, but a quiet server
+    // must call it periodically to close its files and free their connections.
+    void Sweep(std::vector<Handle> &released);
+
+    size_t Size() const {return m_size;}
+    unsigned long long Hits() const {return m_hits;}
+    unsigned long long Misses() const {return m_misses;}
+    unsigned long long Stale() const {return m_stale;}
+
+private:
+    HandleCache(HandleCache const &);
+    HandleCache & operator=(HandleCache const &);
+
+    struct Entry
+    {
+        std::string m_path;
+        std::string m_user;
+        Handle m_handle;
+        long long m_expiry;
+    };
+
+    typedef std::list<Entry> EntryList;
+    typedef std::unordered_multimap<std::string, EntryList::iterator> PathIndex;
+
+    void Erase(PathIndex::iterator index_iter, std::vector<Handle> &released);
+    void Expire(long long now, std::vector<Handle> &released);
+
+    const long long m_ttl_ms;
+    const size_t m_max_entries;
+
+    XrdSysMutex m_mutex;
+    EntryList m_entries; // Most recently cached first.
+    PathIndex m_index;
+    std::atomic<size_t> m_size;
+
+    std::atomic<unsigned long long> m_hits;
+    std::atomic<unsigned long long> m_misses;
+    std::atomic<unsigned long long> m_stale;
+};
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+
+#include "XrdHdfsHarness.hh"
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "XrdVersion.hh"
+#include "XrdOss/XrdOss.hh"
+#include "XrdSys/XrdSysLogger.hh"
+
+using namespace XrdHdfs;
+
+
+namespace
+{
+
+typedef XrdOss *(*GetStorageSystem_t)(XrdOss *, XrdSysLogger *, const char *, const char *);
+
+// The directory holding the running executable.
+std::string
+ExecutableDir()
+{
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len <= 0) {return ".";}
+    path[len] = '\0';
+    char *slash = strrchr(path, '/');
+    if (!slash) {return ".";}
+    *slash = '\0';
+    return path;
+}
+
+// `name` next to the running executable, as in a build tree, or else just
+// `name`, for dlopen to search the library path as for an installed tool.
+std::string
+LibraryPath(const char *name)
+{
+    std::string path = ExecutableDir() + "/" + name;
+    return access(path.c_str(), F_OK) ? name : path;
+}
+
+}
+
+
+Harness::Harness()
+    : m_oss(NULL),
+      m_logger(NULL)
+{
+}
+
+
+Harness::~Harness()
+{
+    if (!m_tmpdir.empty())
+    {
+        std::string cmd = "rm -rf '" + m_tmpdir + "'";
+        if (system(cmd.c_str())) {}
+    }
+}
+
+
+XrdOss *
+Harness::Load(std::string &error)
+{
+    std::string plugin = m_plugin.empty() ? LibraryPath("libXrdHdfsReal-" XRDPLUGIN_SOVERSION ".so") : m_plugin;
+    std::string config = m_config;
+
+    if (config.empty())
+    {
+        char tmpl[] = "/tmp/xrdhdfs-harness.XXXXXX";
+        if (!mkdtemp(tmpl)) {error = "cannot create a temporary directory"; return NULL;}
+        m_tmpdir = tmpl;
+
+        std::string root = m_tmpdir + "/hdfs";
+        if (mkdir(root.c_str(), 0755)) {error = "cannot create " + root; return NULL;}
+        setenv("XRDHDFS_MOCK_ROOT", root.c_str(), 0);
+        m_mock_root = getenv("XRDHDFS_MOCK_ROOT");
+
+        config = m_tmpdir + "/xrootd.cfg";
+        FILE *fp = fopen(config.c_str(), "w");
+        if (!fp) {error = "cannot write " + config; return NULL;}
+        fprintf(fp, "oss.backend native %s\n%s\n",
+                m_mock.empty() ? LibraryPath("libXrdHdfsMock.so").c_str() : m_mock.c_str(),
+                m_directives.c_str());
+        fclose(fp);
+    }
+
+    void *handle = dlopen(plugin.c_str(), RTLD_NOW|RTLD_GLOBAL);
+    if (!handle)
+    {
+        const char *err = dlerror();
+        error = err ? err : plugin;
+        return NULL;
+    }
+    GetStorageSystem_t ep = reinterpret_cast<GetStorageSystem_t>(dlsym(handle, "XrdOssGetStorageSystem"));
+    if (!ep) {error = plugin + " has no XrdOssGetStorageSystem"; return NULL;}
+
+    m_logger = new XrdSysLogger();
+    m_oss = ep(NULL, m_logger, config.c_str(), NULL);
+    if (!m_oss) {error = "plugin initialization failed; see the log above"; return NULL;}
+    return m_oss;
+}
+
+
+unsigned long long
+Harness::Stat(const char *section, const char *tag)
+{
+    if (!m_oss) {return 0;}
+    int len = m_oss->getStats(NULL, 0);
+    std::vector<char> buff(len + 1);
+    m_oss->getStats(&buff[0], len);
+    buff[len] = '\0';
+
+    std::string open_section = std::string("<") + section + ">";
+    std::string open_tag = std::string("<") + tag + ">";
+    const char *pos = strstr(&buff[0], open_section.c_str());
+    if (!pos || !(pos = strstr(pos, open_tag.c_str()))) {return 0;}
+    return strtoull(pos + open_tag.size(), NULL, 10);
+}
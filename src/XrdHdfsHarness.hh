@@ -0,0 +1,57 @@
+
+/*
+ * Runs the Xrootd HDFS plugin in-process, for the benchmark and replay tools.
+ */
+
+#ifndef __XRDHDFS_HARNESS_H__
+#define __XRDHDFS_HARNESS_H__
+
+#include <string>
+
+class XrdOss;
+class XrdSysLogger;
+
+namespace XrdHdfs {
+
+/*
+ * Loads libXrdHdfsReal and initializes it as xrootd would.
+ *
+ * With no configuration file given, the plugin is configured with the mock
+ * libhdfs (libXrdHdfsMock.so) serving a fresh temporary directory, so the
+ * tools run anywhere; extra directives can be added to that configuration.
+ * Plugin and mock are looked for next to the running executable, then in
+ * the library path, unless given explicitly.
+ */
+class Harness
+{
+public:
+    Harness();
+    ~Harness();
+
+    std::string m_plugin;     // Path of libXrdHdfsReal; empty for the default.
+    std::string m_mock;       // Path of libXrdHdfsMock; empty for the default.
+    std::string m_config;     // Configuration file; empty to generate one.
+    std::string m_directives; // Extra lines for a generated configuration.
+
+    // Load and initialize the plugin; returns NULL with `error` set on failure.
+    XrdOss *Load(std::string &error);
+
+    // The local directory the mock serves, if the configuration was generated.
+    const std::string &MockRoot() const {return m_mock_root;}
+
+    // The value of <section><tag> in the plugin's getStats output, or 0.
+    unsigned long long Stat(const char *section, const char *tag);
+
+private:
+    Harness(Harness const &);
+    Harness & operator=(Harness const &);
+
+    XrdOss *m_oss;
+    XrdSysLogger *m_logger;
+    std::string m_tmpdir;
+    std::string m_mock_root;
+};
+
+}
+
+#endif
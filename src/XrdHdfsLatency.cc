@@ -0,0 +1,425 @@
+
+#include "XrdHdfsLatency.hh"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "XrdSys/XrdSysError.hh"
+
+#include "XrdHdfsAccounting.hh"
+
+using namespace XrdHdfs;
+
+
+bool XrdHdfs::g_latency_enabled = true;
+bool XrdHdfs::g_op_tracing = false;
+unsigned long long XrdHdfs::g_slowlog_threshold = 0;
+
+
+namespace
+{
+
+/*
+ * The histograms of one thread, each allocated on the thread's first
+ * recording of its operation.  Blocks are linked into a list which is only
+ * ever pushed to; when a thread exits its block is released for reuse by a
+ * later thread, keeping what it recorded.
+ */
+struct ThreadLatencies
+{
+    ThreadLatencies() : m_in_use(true), m_next(NULL)
+    {
+        for (unsigned idx = 0; idx < LatencyOpCount; idx++) {m_ops[idx] = NULL;}
+    }
+
+    std::atomic<LatencyHistogram *> m_ops[LatencyOpCount];
+    std::atomic<bool> m_in_use;
+    ThreadLatencies *m_next;
+};
+
+std::atomic<ThreadLatencies *> g_threads(NULL);
+
+__thread ThreadLatencies *t_latencies = NULL;
+
+pthread_key_t g_release_key;
+pthread_once_t g_release_once = PTHREAD_ONCE_INIT;
+
+
+void
+ReleaseThread(void *arg)
+{
+    static_cast<ThreadLatencies *>(arg)->m_in_use.store(false, std::memory_order_release);
+}
+
+
+void
+CreateReleaseKey()
+{
+    pthread_key_create(&g_release_key, ReleaseThread);
+}
+
+
+ThreadLatencies *
+AcquireThread()
+{
+    pthread_once(&g_release_once, CreateReleaseKey);
+
+    ThreadLatencies *block = NULL;
+    for (ThreadLatencies *iter = g_threads.load(std::memory_order_acquire); iter; iter = iter->m_next)
+    {
+        bool in_use = false;
+        if (iter->m_in_use.compare_exchange_strong(in_use, true)) {block = iter; break;}
+    }
+    if (!block)
+    {
+        block = new ThreadLatencies();
+        block->m_next = g_threads.load(std::memory_order_relaxed);
+        while (!g_threads.compare_exchange_weak(block->m_next, block)) {}
+    }
+    pthread_setspecific(g_release_key, block);
+    return block;
+}
+
+
+// Where the time of an operation went.
+enum OpPhase
+{
+    PhaseConnect = 0,
+    PhaseNamenode,
+    PhaseData,
+    PhaseChecksum,
+    PhaseNone
+};
+
+const char * const g_phase_names[PhaseNone] = {"connect", "namenode", "data", "checksum"};
+
+OpPhase
+PhaseOf(LatencyOp op)
+{
+    switch (op)
+    {
+    case LatConnect:
+    case LatHdfsConnect:
+    case LatHdfsDisconnect:      return PhaseConnect;
+    case LatHdfsGetPathInfo:
+    case LatHdfsListDirectory:
+    case LatHdfsListIterator:
+    case LatHdfsExists:
+    case LatHdfsCreateDirectory:
+    case LatHdfsChmod:
+    case LatHdfsDelete:
+    case LatHdfsRename:
+    case LatHdfsOpenFile:
+    case LatHdfsCloseFile:       return PhaseNamenode;
+    case LatHdfsPread:
+    case LatHdfsWrite:           return PhaseData;
+    case LatChecksum:            return PhaseChecksum;
+    default:                     return PhaseNone;
+    }
+}
+
+// The operation in progress on this thread; plain data, as __thread needs.
+struct OpTrace
+{
+    unsigned m_depth;       // Timed entry points entered.
+    unsigned m_phase_depth; // Timed calls within a phase entered.
+    bool m_noted;
+    unsigned long long m_bytes;
+    unsigned long long m_phases[PhaseNone];
+    char m_user[256];
+    char m_path[1024];
+};
+
+__thread OpTrace t_op;
+
+XrdSysError *g_slowlog = NULL;
+
+
+void
+CopyTruncated(char *dest, size_t size, const char *src)
+{
+    size_t len = strlen(src);
+    if (len >= size) {len = size - 1;}
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+}
+
+
+void
+LogSlowOp(const OpTrace &trace, LatencyOp op, unsigned long long micros)
+{
+    unsigned long long phases = 0;
+    for (unsigned idx = 0; idx < PhaseNone; idx++) {phases += trace.m_phases[idx];}
+
+    char line[1536];
+    int len = snprintf(line, sizeof(line), "op=%s user=%s path=%s bytes=%llu total_us=%llu",
+                       LatencyOpName(op), trace.m_user[0] ? trace.m_user : "-",
+                       trace.m_path[0] ? trace.m_path : "-", trace.m_bytes, micros);
+    for (unsigned idx = 0; (idx < PhaseNone) && (len > 0) && (len < static_cast<int>(sizeof(line))); idx++)
+    {
+        len += snprintf(line + len, sizeof(line) - len, " %s_us=%llu", g_phase_names[idx], trace.m_phases[idx]);
+    }
+    if ((len > 0) && (len < static_cast<int>(sizeof(line))))
+    {
+        // The rest is spent in the plugin itself: name translation, caches,
+        // copying and waiting for admission.
+        snprintf(line + len, sizeof(line) - len, " other_us=%llu", micros > phases ? micros - phases : 0);
+    }
+    g_slowlog->Say("hdfs slow ", line);
+}
+
+}
+
+
+const char *
+XrdHdfs::LatencyOpName(LatencyOp op)
+{
+    switch (op)
+    {
+    case LatStat:                return "stat";
+    case LatCreate:              return "create";
+    case LatMkdir:               return "mkdir";
+    case LatRemdir:              return "remdir";
+    case LatRename:              return "rename";
+    case LatTruncate:            return "truncate";
+    case LatUnlink:              return "unlink";
+    case LatChmod:               return "chmod";
+    case LatOpen:                return "open";
+    case LatRead:                return "read";
+    case LatWrite:               return "write";
+    case LatFstat:               return "fstat";
+    case LatClose:               return "close";
+    case LatOpendir:             return "opendir";
+    case LatReaddir:             return "readdir";
+    case LatClosedir:            return "closedir";
+    case LatN2N:                 return "n2n";
+    case LatConnect:             return "connect";
+    case LatChecksum:            return "checksum";
+    case LatHdfsConnect:         return "hdfsConnect";
+    case LatHdfsDisconnect:      return "hdfsDisconnect";
+    case LatHdfsGetPathInfo:     return "hdfsGetPathInfo";
+    case LatHdfsListDirectory:   return "hdfsListDirectory";
+    case LatHdfsListIterator:    return "listStatusIterator";
+    case LatHdfsExists:          return "hdfsExists";
+    case LatHdfsCreateDirectory: return "hdfsCreateDirectory";
+    case LatHdfsChmod:           return "hdfsChmod";
+    case LatHdfsDelete:          return "hdfsDelete";
+    case LatHdfsRename:          return "hdfsRename";
+    case LatHdfsOpenFile:        return "hdfsOpenFile";
+    case LatHdfsCloseFile:       return "hdfsCloseFile";
+    case LatHdfsPread:           return "hdfsPread";
+    case LatHdfsWrite:           return "hdfsWrite";
+    default:                     return "unknown";
+    }
+}
+
+
+LatencyHistogram::LatencyHistogram()
+    : m_count(0),
+      m_sum(0),
+      m_max(0)
+{
+    for (unsigned idx = 0; idx < BucketCount; idx++) {m_buckets[idx] = 0;}
+}
+
+
+unsigned
+LatencyHistogram::Bucket(unsigned long long micros)
+{
+    if (micros < SubBuckets) {return micros;}
+    if (micros >> MaxBits) {return BucketCount - 1;}
+    unsigned magnitude = 63 - __builtin_clzll(micros);
+    unsigned shift = magnitude - SubBucketBits;
+    return SubBuckets + shift * SubBuckets + ((micros >> shift) & (SubBuckets - 1));
+}
+
+
+unsigned long long
+LatencyHistogram::BucketHigh(unsigned bucket)
+{
+    if (bucket < SubBuckets) {return bucket;}
+    unsigned shift = (bucket - SubBuckets) / SubBuckets;
+    unsigned long long low = static_cast<unsigned long long>(SubBuckets + (bucket % SubBuckets)) << shift;
+    return low + (1ULL << shift) - 1;
+}
+
+
+void
+LatencyHistogram::Record(unsigned long long micros)
+{
+    std::atomic<unsigned long long> &bucket = m_buckets[Bucket(micros)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_sum.store(m_sum.load(std::memory_order_relaxed) + micros, std::memory_order_relaxed);
+    if (micros > m_max.load(std::memory_order_relaxed)) {m_max.store(micros, std::memory_order_relaxed);}
+}
+
+
+void
+LatencyHistogram::Add(const LatencyHistogram &other)
+{
+    for (unsigned idx = 0; idx < BucketCount; idx++)
+    {
+        m_buckets[idx] += other.m_buckets[idx].load(std::memory_order_relaxed);
+    }
+    m_count += other.Count();
+    m_sum += other.Sum();
+    if (other.Max() > Max()) {m_max = other.Max();}
+}
+
+
+unsigned long long
+LatencyHistogram::Percentile(double fraction) const
+{
+    unsigned long long count = Count();
+    if (!count) {return 0;}
+    unsigned long long rank = static_cast<unsigned long long>(fraction * count + 0.5);
+    if (rank < 1) {rank = 1;}
+
+    unsigned long long seen = 0;
+    for (unsigned idx = 0; idx < BucketCount; idx++)
+    {
+        seen += m_buckets[idx].load(std::memory_order_relaxed);
+        if (seen >= rank) {return std::min(BucketHigh(idx), Max());}
+    }
+    return Max();
+}
+
+
+void
+XrdHdfs::RecordLatency(LatencyOp op, unsigned long long micros)
+{
+    if (!t_latencies) {t_latencies = AcquireThread();}
+    LatencyHistogram *hist = t_latencies->m_ops[op].load(std::memory_order_relaxed);
+    if (!hist)
+    {
+        hist = new LatencyHistogram();
+        t_latencies->m_ops[op].store(hist, std::memory_order_release);
+    }
+    hist->Record(micros);
+}
+
+
+void
+XrdHdfs::EnableSlowLog(XrdSysError &log, unsigned long long threshold)
+{
+    g_slowlog = &log;
+    g_slowlog_threshold = threshold;
+    g_op_tracing = true;
+}
+
+
+void
+XrdHdfs::OpTraceEnter(LatencyOp op)
+{
+    OpTrace &trace = t_op;
+    if (op < LatN2N)
+    {
+        if (trace.m_depth++) {return;}
+        trace.m_noted = false;
+        trace.m_bytes = 0;
+        for (unsigned idx = 0; idx < PhaseNone; idx++) {trace.m_phases[idx] = 0;}
+        trace.m_user[0] = '\0';
+        trace.m_path[0] = '\0';
+    }
+    else if (PhaseOf(op) != PhaseNone)
+    {
+        trace.m_phase_depth++;
+    }
+}
+
+
+void
+XrdHdfs::OpTraceLeave(LatencyOp op, unsigned long long micros)
+{
+    OpTrace &trace = t_op;
+    if (op < LatN2N)
+    {
+        if (!trace.m_depth || --trace.m_depth) {return;}
+        if (g_accounting)
+        {
+            unsigned long long hdfs = trace.m_phases[PhaseConnect] + trace.m_phases[PhaseNamenode]
+                                      + trace.m_phases[PhaseData];
+            g_accounting->Record(trace.m_user, trace.m_path, (op == LatRead) ? trace.m_bytes : 0,
+                                 (op == LatWrite) ? trace.m_bytes : 0, hdfs);
+        }
+        if (g_slowlog_threshold && (micros >= g_slowlog_threshold)) {LogSlowOp(trace, op, micros);}
+        return;
+    }
+    OpPhase phase = PhaseOf(op);
+    if (phase == PhaseNone || !trace.m_phase_depth) {return;}
+    // Only the outermost call of a phase counts; a connect may call others.
+    if (!--trace.m_phase_depth && trace.m_depth) {trace.m_phases[phase] += micros;}
+}
+
+
+void
+XrdHdfs::OpTraceSetDetails(const std::string &user, const char *path)
+{
+    OpTrace &trace = t_op;
+    if (trace.m_depth != 1 || trace.m_noted) {return;}
+    trace.m_noted = true;
+    CopyTruncated(trace.m_user, sizeof(trace.m_user), user.c_str());
+    CopyTruncated(trace.m_path, sizeof(trace.m_path), path ? path : "");
+}
+
+
+void
+XrdHdfs::OpTraceAddBytes(unsigned long long bytes)
+{
+    OpTrace &trace = t_op;
+    if (trace.m_depth == 1) {trace.m_bytes += bytes;}
+}
+
+
+void
+XrdHdfs::LatencySnapshot(LatencyOp op, LatencyHistogram &result)
+{
+    for (ThreadLatencies *iter = g_threads.load(std::memory_order_acquire); iter; iter = iter->m_next)
+    {
+        LatencyHistogram *hist = iter->m_ops[op].load(std::memory_order_acquire);
+        if (hist) {result.Add(*hist);}
+    }
+}
+
+
+std::string
+XrdHdfs::LatencyStats()
+{
+    std::string result;
+    for (unsigned op = 0; op < LatencyOpCount; op++)
+    {
+        LatencyHistogram hist;
+        LatencySnapshot(static_cast<LatencyOp>(op), hist);
+        if (!hist.Count()) {continue;}
+
+        const char *name = LatencyOpName(static_cast<LatencyOp>(op));
+        char entry[256];
+        snprintf(entry, sizeof(entry), "<%s><n>%llu</n><p50>%llu</p50><p90>%llu</p90><p99>%llu</p99><max>%llu</max></%s>",
+                 name, hist.Count(), hist.Percentile(0.5), hist.Percentile(0.9),
+                 hist.Percentile(0.99), hist.Max(), name);
+        result += entry;
+    }
+    return result;
+}
+
+
+void
+XrdHdfs::LatencyReport(std::vector<std::string> &lines)
+{
+    for (unsigned op = 0; op < LatencyOpCount; op++)
+    {
+        LatencyHistogram hist;
+        LatencySnapshot(static_cast<LatencyOp>(op), hist);
+        if (!hist.Count()) {continue;}
+
+        char line[256];
+        snprintf(line, sizeof(line), "%s n=%llu mean=%lluus p50=%lluus p90=%lluus p99=%lluus max=%lluus",
+                 LatencyOpName(static_cast<LatencyOp>(op)), hist.Count(), hist.Sum() / hist.Count(),
+                 hist.Percentile(0.5), hist.Percentile(0.9), hist.Percentile(0.99), hist.Max());
+        lines.push_back(line);
+    }
+}
@@ -0,0 +1,200 @@
+
+/*
+ * Latency histograms, the slow-operation log and the tracing of operations
+ * for I/O accounting in the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_LATENCY_H__
+#define __XRDHDFS_LATENCY_H__
+
+#include <errno.h>
+#include <time.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+class XrdSysError;
+
+namespace XrdHdfs {
+
+// What is timed: the plugin's entry points, steps within them, and each
+// libhdfs call.  The entry points come first, before LatN2N.
+enum LatencyOp
+{
+    LatStat = 0,
+    LatCreate,
+    LatMkdir,
+    LatRemdir,
+    LatRename,
+    LatTruncate,
+    LatUnlink,
+    LatChmod,
+    LatOpen,
+    LatRead,
+    LatWrite,
+    LatFstat,
+    LatClose,
+    LatOpendir,
+    LatReaddir,
+    LatClosedir,
+    LatN2N,      // GetRealPath.
+    LatConnect,  // Getting a connection for a user, pooled or new.
+    LatChecksum, // Computing the checksums of a file being written.
+    LatHdfsConnect,
+    LatHdfsDisconnect,
+    LatHdfsGetPathInfo,
+    LatHdfsListDirectory,
+    LatHdfsListIterator, // Opening, or paging through, a streamed listing.
+    LatHdfsExists,
+    LatHdfsCreateDirectory,
+    LatHdfsChmod,
+    LatHdfsDelete,
+    LatHdfsRename,
+    LatHdfsOpenFile,
+    LatHdfsCloseFile,
+    LatHdfsPread,
+    LatHdfsWrite,
+    LatencyOpCount
+};
+
+const char *LatencyOpName(LatencyOp op);
+
+/*
+ * A histogram of latencies in microseconds, in the style of HdrHistogram:
+ * buckets are exact below 16us, then each power of two is split into 16
+ * buckets, so any value is known to within 1/16th (6.25%) up to 2^36us.
+ *
+ * Each thread records into its own histograms, so a histogram has a single
+ * writer and needs no atomic read-modify-write; readers may see a recording
+ * half done, which only skews a summary by one sample.
+ */
+class LatencyHistogram
+{
+public:
+    static const unsigned SubBucketBits = 4;
+    static const unsigned SubBuckets = 1 << SubBucketBits;
+    static const unsigned MaxBits = 36;
+    static const unsigned BucketCount = SubBuckets + (MaxBits - SubBucketBits) * SubBuckets;
+
+    LatencyHistogram();
+
+    // Record one latency; only from the histogram's owner.
+    void Record(unsigned long long micros);
+
+    // Add the contents of `other` to this histogram; not for one being
+    // recorded into.
+    void Add(const LatencyHistogram &other);
+
+    unsigned long long Count() const {return m_count.load(std::memory_order_relaxed);}
+    unsigned long long Sum() const {return m_sum.load(std::memory_order_relaxed);}
+    unsigned long long Max() const {return m_max.load(std::memory_order_relaxed);}
+
+    // The latency below which `fraction` of those recorded fall.
+    unsigned long long Percentile(double fraction) const;
+
+private:
+    LatencyHistogram(LatencyHistogram const &);
+    LatencyHistogram & operator=(LatencyHistogram const &);
+
+    static unsigned Bucket(unsigned long long micros);
+    static unsigned long long BucketHigh(unsigned bucket);
+
+    std::atomic<unsigned long long> m_buckets[BucketCount];
+    std::atomic<unsigned long long> m_count;
+    std::atomic<unsigned long long> m_sum;
+    std::atomic<unsigned long long> m_max;
+};
+
+// Record a latency for `op` in the calling thread's histograms.
+void RecordLatency(LatencyOp op, unsigned long long micros);
+
+// Add the histograms of all threads for `op` to `result`.
+void LatencySnapshot(LatencyOp op, LatencyHistogram &result);
+
+// Whether latencies are recorded; set at configuration time.
+extern bool g_latency_enabled;
+
+/*
+ * Tracing of operations.  The outermost timed entry point on a thread is an
+ * operation; the time of the connect, namenode, data and checksum calls timed
+ * within it is summed by phase.  When it ends, the operation is accounted to
+ * its user and path prefix (see XrdHdfsAccounting.hh), and logged, phases and
+ * all, if it took at least the slow-operation threshold.  Tracing costs an
+ * operation a few thread-local additions and copying its user and path.
+ */
+
+// Whether operations are traced; set at configuration time, by EnableSlowLog
+// or along with g_accounting.
+extern bool g_op_tracing;
+
+// Log operations taking at least this many microseconds; 0 if off.
+extern unsigned long long g_slowlog_threshold;
+
+void EnableSlowLog(XrdSysError &log, unsigned long long threshold);
+
+void OpTraceEnter(LatencyOp op);
+void OpTraceLeave(LatencyOp op, unsigned long long micros);
+void OpTraceSetDetails(const std::string &user, const char *path);
+void OpTraceAddBytes(unsigned long long bytes);
+
+// Who the current operation is for and what it is on; the first noted wins.
+inline void NoteOp(const std::string &user, const char *path)
+{
+    if (g_op_tracing) {OpTraceSetDetails(user, path);}
+}
+
+// Bytes read or written by the current operation.
+inline void NoteOpBytes(long long bytes)
+{
+    if (g_op_tracing && (bytes > 0)) {OpTraceAddBytes(bytes);}
+}
+
+// Times the enclosing scope as one `op`.
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(LatencyOp op)
+        : m_op(op),
+          m_traced(g_op_tracing),
+          m_timed(g_latency_enabled || m_traced)
+    {
+        if (!m_timed) {return;}
+        clock_gettime(CLOCK_MONOTONIC, &m_start);
+        if (m_traced) {OpTraceEnter(m_op);}
+    }
+
+    ~LatencyTimer()
+    {
+        if (!m_timed) {return;}
+        // Callers report errors through errno; leave it as the timed code left it.
+        int saved_errno = errno;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long long micros = (now.tv_sec - m_start.tv_sec) * 1000000LL + (now.tv_nsec - m_start.tv_nsec) / 1000;
+        if (micros < 0) {micros = 0;}
+        if (g_latency_enabled) {RecordLatency(m_op, micros);}
+        if (m_traced) {OpTraceLeave(m_op, micros);}
+        errno = saved_errno;
+    }
+
+private:
+    LatencyTimer(LatencyTimer const &);
+    LatencyTimer & operator=(LatencyTimer const &);
+
+    LatencyOp m_op;
+    bool m_traced;
+    bool m_timed;
+    struct timespec m_start;
+};
+
+// Summaries of every operation recorded so far, for getStats: each as
+// <name><n/><p50/><p90/><p99/><max/></name>, in microseconds.
+std::string LatencyStats();
+
+// The same, as one line per operation, for the log.
+void LatencyReport(std::vector<std::string> &lines);
+
+}
+
+#endif
@@ -0,0 +1,366 @@
+
+#include "XrdHdfsListing.hh"
+#include "XrdHdfsBackend.hh"
+#include "XrdHdfsLatency.hh"
+#include "XrdHdfsSched.hh"
+#include "XrdHdfsWorkers.hh"
+
+#include <errno.h>
+#include <dlfcn.h>
+#include <string.h>
+
+#include <jni.h>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+using namespace XrdHdfs;
+
+
+namespace
+{
+
+typedef jint (*GetCreatedJavaVMs_t)(JavaVM **, jsize, jsize *);
+
+struct JniRefs
+{
+    bool m_initialized;
+    bool m_ok;
+
+    jclass m_path;
+    jmethodID m_path_ctor;
+    jmethodID m_path_tostring;
+
+    jclass m_filesystem;
+    jmethodID m_list_status_iterator;
+
+    jclass m_remote_iterator;
+    jmethodID m_has_next;
+    jmethodID m_next;
+
+    jclass m_file_status;
+    jmethodID m_get_path;
+    jmethodID m_is_directory;
+    jmethodID m_get_len;
+    jmethodID m_get_modification_time;
+    jmethodID m_get_permission;
+
+    jclass m_fs_permission;
+    jmethodID m_to_short;
+
+    jclass m_file_not_found;
+    jclass m_access_control;
+};
+
+XrdSysMutex g_jni_mutex;
+JavaVM *g_jvm = NULL;
+JniRefs g_refs;
+
+
+/*
+ * Return a JNIEnv for the current thread, attaching it if needed.  We look up
+ * the JVM at runtime rather than linking libjvm so that the plugin still loads
+ * (and simply falls back to hdfsListDirectory) when no JVM is present.
+ */
+JNIEnv *
+AttachedEnv()
+{
+    if (!g_jvm)
+    {
+        XrdSysMutexHelper lock(g_jni_mutex);
+        if (!g_jvm)
+        {
+            GetCreatedJavaVMs_t get_vms = reinterpret_cast<GetCreatedJavaVMs_t>(dlsym(RTLD_DEFAULT, "JNI_GetCreatedJavaVMs"));
+            JavaVM *vm = NULL;
+            jsize vm_count = 0;
+            if (!get_vms || (get_vms(&vm, 1, &vm_count) != JNI_OK) || !vm_count)
+            {
+                return NULL;
+            }
+            g_jvm = vm;
+        }
+    }
+
+    JNIEnv *env = NULL;
+    jint rc = g_jvm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_2);
+    if (rc == JNI_EDETACHED)
+    {
+        rc = g_jvm->AttachCurrentThreadAsDaemon(reinterpret_cast<void **>(&env), NULL);
+    }
+    return (rc == JNI_OK) ? env : NULL;
+}
+
+
+jclass
+GlobalClass(JNIEnv *env, const char *name)
+{
+    jclass local = env->FindClass(name);
+    if (!local)
+    {
+        env->ExceptionClear();
+        return NULL;
+    }
+    jclass global = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+
+bool
+InitRefs(JNIEnv *env)
+{
+    XrdSysMutexHelper lock(g_jni_mutex);
+    if (g_refs.m_initialized) {return g_refs.m_ok;}
+    g_refs.m_initialized = true;
+
+    JniRefs &r = g_refs;
+    if (!(r.m_path = GlobalClass(env, "org/apache/hadoop/fs/Path")) ||
+        !(r.m_filesystem = GlobalClass(env, "org/apache/hadoop/fs/FileSystem")) ||
+        !(r.m_remote_iterator = GlobalClass(env, "org/apache/hadoop/fs/RemoteIterator")) ||
+        !(r.m_file_status = GlobalClass(env, "org/apache/hadoop/fs/FileStatus")) ||
+        !(r.m_fs_permission = GlobalClass(env, "org/apache/hadoop/fs/permission/FsPermission")))
+    {
+        return false;
+    }
+    // Used only for error translation; not fatal if missing.
+    r.m_file_not_found = GlobalClass(env, "java/io/FileNotFoundException");
+    r.m_access_control = GlobalClass(env, "org/apache/hadoop/security/AccessControlException");
+
+    r.m_path_ctor = env->GetMethodID(r.m_path, "<init>", "(Ljava/lang/String;)V");
+    r.m_path_tostring = env->GetMethodID(r.m_path, "toString", "()Ljava/lang/String;");
+    r.m_list_status_iterator = env->GetMethodID(r.m_filesystem, "listStatusIterator",
+        "(Lorg/apache/hadoop/fs/Path;)Lorg/apache/hadoop/fs/RemoteIterator;");
+    r.m_has_next = env->GetMethodID(r.m_remote_iterator, "hasNext", "()Z");
+    r.m_next = env->GetMethodID(r.m_remote_iterator, "next", "()Ljava/lang/Object;");
+    r.m_get_path = env->GetMethodID(r.m_file_status, "getPath", "()Lorg/apache/hadoop/fs/Path;");
+    r.m_is_directory = env->GetMethodID(r.m_file_status, "isDirectory", "()Z");
+    r.m_get_len = env->GetMethodID(r.m_file_status, "getLen", "()J");
+    r.m_get_modification_time = env->GetMethodID(r.m_file_status, "getModificationTime", "()J");
+    r.m_get_permission = env->GetMethodID(r.m_file_status, "getPermission",
+        "()Lorg/apache/hadoop/fs/permission/FsPermission;");
+    r.m_to_short = env->GetMethodID(r.m_fs_permission, "toShort", "()S");
+
+    if (env->ExceptionCheck())
+    {
+        env->ExceptionClear();
+        return false;
+    }
+    r.m_ok = r.m_path_ctor && r.m_path_tostring && r.m_list_status_iterator &&
+             r.m_has_next && r.m_next && r.m_get_path && r.m_is_directory &&
+             r.m_get_len && r.m_get_modification_time && r.m_get_permission &&
+             r.m_to_short;
+    return r.m_ok;
+}
+
+
+// Clear the pending Java exception and translate it to an errno value.
+int
+ExceptionToErrno(JNIEnv *env)
+{
+    jthrowable exc = env->ExceptionOccurred();
+    env->ExceptionClear();
+    int err = EIO;
+    if (exc)
+    {
+        if (g_refs.m_file_not_found && env->IsInstanceOf(exc, g_refs.m_file_not_found))
+        {
+            err = ENOENT;
+        }
+        else if (g_refs.m_access_control && env->IsInstanceOf(exc, g_refs.m_access_control))
+        {
+            err = EACCES;
+        }
+        env->DeleteLocalRef(exc);
+    }
+    return err;
+}
+
+}
+
+
+DirectoryStream::DirectoryStream()
+    : m_iter(NULL)
+{
+}
+
+
+DirectoryStream::~DirectoryStream()
+{
+    Close();
+}
+
+
+bool
+DirectoryStream::Available()
+{
+    // Only libhdfs's hdfsFS is a FileSystem reference; another JVM in the
+    // process says nothing about the backend in use.
+    if (g_backend.m_kind != Backend::Libhdfs) {return false;}
+    JNIEnv *env = AttachedEnv();
+    return env && InitRefs(env);
+}
+
+
+int
+DirectoryStream::Open(hdfsFS fs, const char *path)
+{
+    Close();
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsListIterator);
+    return CallHdfs([&]() {return OpenIterator(fs, path);});
+}
+
+
+int
+DirectoryStream::Next(hdfsFileInfo &info)
+{
+    Scheduler::Slot slot(g_scheduler);
+    LatencyTimer timer(LatHdfsListIterator);
+    return CallHdfs([&]() {return NextEntry(info);});
+}
+
+
+void
+DirectoryStream::Close()
+{
+    CallHdfs([&]() {CloseIterator(); return 0;});
+}
+
+
+int
+DirectoryStream::OpenIterator(hdfsFS fs, const char *path)
+{
+    if (g_backend.m_kind != Backend::Libhdfs) {return -ENOTSUP;}
+    JNIEnv *env = AttachedEnv();
+    if (!env || !InitRefs(env)) {return -ENOTSUP;}
+
+    // Native threads never return to Java, so local references are only
+    // released if we do it ourselves.
+    if (env->PushLocalFrame(8) < 0)
+    {
+        env->ExceptionClear();
+        return -ENOMEM;
+    }
+
+    int rc = 0;
+    jstring jpath_str = env->NewStringUTF(path);
+    jobject jpath = jpath_str ? env->NewObject(g_refs.m_path, g_refs.m_path_ctor, jpath_str) : NULL;
+    // libhdfs represents an hdfsFS as a global reference to the FileSystem.
+    jobject iter = jpath ? env->CallObjectMethod(reinterpret_cast<jobject>(fs),
+                                                 g_refs.m_list_status_iterator, jpath) : NULL;
+    if (env->ExceptionCheck())
+    {
+        rc = -ExceptionToErrno(env);
+    }
+    else if (!iter)
+    {
+        rc = -EIO;
+    }
+    else
+    {
+        m_iter = env->NewGlobalRef(iter);
+    }
+
+    env->PopLocalFrame(NULL);
+    return rc;
+}
+
+
+int
+DirectoryStream::NextEntry(hdfsFileInfo &info)
+{
+    if (!m_iter) {return 0;}
+
+    JNIEnv *env = AttachedEnv();
+    if (!env) {return -EIO;}
+
+    if (env->PushLocalFrame(16) < 0)
+    {
+        env->ExceptionClear();
+        return -ENOMEM;
+    }
+
+    int rc = 1;
+    jobject status = NULL, jpath = NULL, perm = NULL;
+    jstring jname = NULL;
+    const char *name = NULL;
+
+    // hasNext() is where the next page is fetched from the namenode.
+    jboolean more = env->CallBooleanMethod(m_iter, g_refs.m_has_next);
+    if (env->ExceptionCheck()) {rc = -ExceptionToErrno(env); goto cleanup;}
+    if (!more) {rc = 0; goto cleanup;}
+
+    status = env->CallObjectMethod(m_iter, g_refs.m_next);
+    if (env->ExceptionCheck() || !status) {rc = -ExceptionToErrno(env); goto cleanup;}
+
+    jpath = env->CallObjectMethod(status, g_refs.m_get_path);
+    jname = jpath ? static_cast<jstring>(env->CallObjectMethod(jpath, g_refs.m_path_tostring)) : NULL;
+    perm = env->CallObjectMethod(status, g_refs.m_get_permission);
+    if (env->ExceptionCheck() || !jname || !perm) {rc = -ExceptionToErrno(env); goto cleanup;}
+
+    // Mirror what hdfsListDirectory would have reported for this entry.
+    memset(&info, 0, sizeof(info));
+    info.mKind = env->CallBooleanMethod(status, g_refs.m_is_directory) ?
+                 kObjectKindDirectory : kObjectKindFile;
+    info.mSize = env->CallLongMethod(status, g_refs.m_get_len);
+    info.mLastMod = env->CallLongMethod(status, g_refs.m_get_modification_time) / 1000;
+    info.mPermissions = env->CallShortMethod(perm, g_refs.m_to_short);
+    if (env->ExceptionCheck()) {rc = -ExceptionToErrno(env); goto cleanup;}
+
+    if (!(name = env->GetStringUTFChars(jname, NULL))) {rc = -ENOMEM; goto cleanup;}
+    m_name = name;
+    env->ReleaseStringUTFChars(jname, name);
+    info.mName = const_cast<char *>(m_name.c_str());
+
+cleanup:
+    env->PopLocalFrame(NULL);
+    if (rc <= 0)
+    {
+        CloseIterator();
+    }
+    return rc;
+}
+
+
+void
+DirectoryStream::CloseIterator()
+{
+    if (!m_iter) {return;}
+
+    JNIEnv *env = AttachedEnv();
+    if (env)
+    {
+        env->DeleteGlobalRef(m_iter);
+    }
+    m_iter = NULL;
+}
+
+
+bool
+XrdHdfs::JvmHeapUsage(long long &used, long long &committed, long long &max)
+{
+    JNIEnv *env = AttachedEnv();
+    if (!env || (env->PushLocalFrame(4) < 0))
+    {
+        if (env) {env->ExceptionClear();}
+        return false;
+    }
+
+    bool ok = false;
+    jclass runtime_class = env->FindClass("java/lang/Runtime");
+    jmethodID get_runtime = runtime_class ? env->GetStaticMethodID(runtime_class, "getRuntime", "()Ljava/lang/Runtime;") : NULL;
+    jmethodID total_memory = runtime_class ? env->GetMethodID(runtime_class, "totalMemory", "()J") : NULL;
+    jmethodID free_memory = runtime_class ? env->GetMethodID(runtime_class, "freeMemory", "()J") : NULL;
+    jmethodID max_memory = runtime_class ? env->GetMethodID(runtime_class, "maxMemory", "()J") : NULL;
+    jobject runtime = (get_runtime && total_memory && free_memory && max_memory) ?
+                      env->CallStaticObjectMethod(runtime_class, get_runtime) : NULL;
+    if (runtime && !env->ExceptionCheck())
+    {
+        committed = env->CallLongMethod(runtime, total_memory);
+        used = committed - env->CallLongMethod(runtime, free_memory);
+        max = env->CallLongMethod(runtime, max_memory);
+        ok = !env->ExceptionCheck();
+    }
+    env->ExceptionClear();
+    env->PopLocalFrame(NULL);
+    return ok;
+}
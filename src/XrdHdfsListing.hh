@@ -0,0 +1,69 @@
+
+/*
+ * Direct JNI access to Hadoop for the Xrootd HDFS plugin, for what libhdfs
+ * does not offer: incremental directory listings and JVM memory usage.
+ */
+
+#ifndef __XRDHDFS_LISTING_H__
+#define __XRDHDFS_LISTING_H__
+
+#include <string>
+
+#include "hdfs.h"
+
+class _jobject;
+
+namespace XrdHdfs {
+
+/*
+ * Stream the contents of a directory a page at a time.
+ *
+ * libhdfs only offers hdfsListDirectory, which materializes the entire
+ * listing before returning.  For directories with hundreds of thousands of
+ * entries that means a large allocation and a long wait for the first entry.
+ * This class instead drives Hadoop's FileSystem.listStatusIterator over JNI;
+ * the DFS client behind it fetches the listing from the namenode in pages of
+ * dfs.ls.limit entries, so memory use is bounded regardless of directory size.
+ *
+ * The iterator may be advanced from any thread; each call attaches the
+ * calling thread to the JVM if libhdfs has not already done so.
+ */
+class DirectoryStream
+{
+public:
+    DirectoryStream();
+
+    ~DirectoryStream();
+
+    // Start listing `path`.  Returns 0 on success or -errno.
+    int Open(hdfsFS fs, const char *path);
+
+    // Fetch the next entry into `info`.  Returns 1 if an entry was produced,
+    // 0 at the end of the directory and -errno on error.  Pointers inside
+    // `info` remain valid until the next call.
+    int Next(hdfsFileInfo &info);
+
+    void Close();
+
+    // True if a JVM is running and the Hadoop classes we need were found.
+    static bool Available();
+
+private:
+    DirectoryStream(DirectoryStream const &);
+    DirectoryStream & operator=(DirectoryStream const &);
+
+    // The JNI work behind Open, Next and Close, run wherever libhdfs calls are.
+    int OpenIterator(hdfsFS fs, const char *path);
+    int NextEntry(hdfsFileInfo &info);
+    void CloseIterator();
+
+    _jobject *m_iter;   // Global reference to a RemoteIterator<FileStatus>.
+    std::string m_name; // Backing storage for info.mName.
+};
+
+// Report the JVM's heap usage, in bytes.  Returns false if no JVM is running.
+bool JvmHeapUsage(long long &used, long long &committed, long long &max);
+
+}
+
+#endif
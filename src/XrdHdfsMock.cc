@@ -0,0 +1,402 @@
+
+/*
+ * A stand-in for libhdfs that serves a local directory.
+ *
+ * Implements the hdfs.h calls the plugin makes on top of the directory named
+ * by XRDHDFS_MOCK_ROOT (default /tmp/xrdhdfs-mock), so the plugin can be run
+ * and measured without a Hadoop cluster or a JVM.  Load it with
+ *
+ *     oss.backend native /path/to/libXrdHdfsMock.so
+ *
+ * Each call can be slowed down and made to fail, as set in the environment:
+ *
+ *     XRDHDFS_MOCK_META_LATENCY   microseconds added to each metadata call.
+ *     XRDHDFS_MOCK_DATA_LATENCY   microseconds added to each read or write.
+ *     XRDHDFS_MOCK_BANDWIDTH      bytes per second each read or write moves
+ *                                 at (0 for unlimited).
+ *     XRDHDFS_MOCK_ERROR_RATE     fraction of calls that fail (0 to 1).
+ *     XRDHDFS_MOCK_ERRNO          errno of the failures (default EIO).
+ */
+
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "hdfs.h"
+
+namespace
+{
+
+struct MockFS
+{
+    std::string m_user;
+};
+
+struct MockFile
+{
+    int m_fd;
+};
+
+struct Settings
+{
+    std::string m_root;
+    long long m_meta_latency_us;
+    long long m_data_latency_us;
+    long long m_bandwidth;
+    double m_error_rate;
+    int m_errno;
+};
+
+Settings g_settings;
+pthread_once_t g_settings_once = PTHREAD_ONCE_INIT;
+
+__thread unsigned t_seed = 0;
+
+
+long long
+EnvNumber(const char *name, long long dflt)
+{
+    const char *val = getenv(name);
+    return (val && *val) ? strtoll(val, NULL, 10) : dflt;
+}
+
+
+void
+LoadSettings()
+{
+    const char *root = getenv("XRDHDFS_MOCK_ROOT");
+    g_settings.m_root = (root && *root) ? root : "/tmp/xrdhdfs-mock";
+    g_settings.m_meta_latency_us = EnvNumber("XRDHDFS_MOCK_META_LATENCY", 0);
+    g_settings.m_data_latency_us = EnvNumber("XRDHDFS_MOCK_DATA_LATENCY", 0);
+    g_settings.m_bandwidth = EnvNumber("XRDHDFS_MOCK_BANDWIDTH", 0);
+    const char *rate = getenv("XRDHDFS_MOCK_ERROR_RATE");
+    g_settings.m_error_rate = (rate && *rate) ? strtod(rate, NULL) : 0;
+    g_settings.m_errno = EnvNumber("XRDHDFS_MOCK_ERRNO", EIO);
+}
+
+
+const Settings &
+GetSettings()
+{
+    pthread_once(&g_settings_once, LoadSettings);
+    return g_settings;
+}
+
+
+void
+SleepMicros(long long micros)
+{
+    if (micros <= 0) {return;}
+    struct timespec ts;
+    ts.tv_sec = micros / 1000000;
+    ts.tv_nsec = (micros % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) && (errno == EINTR)) {}
+}
+
+
+// Apply the latency of one call moving `bytes` bytes of data (-1 for a
+// metadata call).  Returns false, with errno set, if the call is to fail.
+bool
+Enter(long long bytes)
+{
+    const Settings &settings = GetSettings();
+    int saved_errno = errno;
+    if (bytes < 0)
+    {
+        SleepMicros(settings.m_meta_latency_us);
+    }
+    else
+    {
+        long long transfer_us = settings.m_bandwidth ? bytes * 1000000 / settings.m_bandwidth : 0;
+        SleepMicros(settings.m_data_latency_us + transfer_us);
+    }
+
+    if (settings.m_error_rate > 0)
+    {
+        if (!t_seed) {t_seed = static_cast<unsigned>(time(NULL)) ^ static_cast<unsigned>(pthread_self());}
+        if (rand_r(&t_seed) < settings.m_error_rate * RAND_MAX)
+        {
+            errno = settings.m_errno;
+            return false;
+        }
+    }
+    errno = saved_errno;
+    return true;
+}
+
+
+std::string
+LocalPath(const char *path)
+{
+    return GetSettings().m_root + path;
+}
+
+
+bool
+FillInfo(const char *path, const struct stat &st, const char *owner, hdfsFileInfo &info)
+{
+    std::string name = std::string("hdfs://mock") + path;
+    memset(&info, 0, sizeof(info));
+    info.mKind = S_ISDIR(st.st_mode) ? kObjectKindDirectory : kObjectKindFile;
+    info.mName = strdup(name.c_str());
+    info.mLastMod = st.st_mtime;
+    info.mSize = S_ISDIR(st.st_mode) ? 0 : st.st_size;
+    info.mReplication = S_ISDIR(st.st_mode) ? 0 : 1;
+    info.mBlockSize = S_ISDIR(st.st_mode) ? 0 : 128*1024*1024;
+    info.mOwner = strdup(owner);
+    info.mGroup = strdup(owner);
+    info.mPermissions = st.st_mode & 07777;
+    info.mLastAccess = st.st_atime;
+    return info.mName && info.mOwner && info.mGroup;
+}
+
+
+int
+RemoveEntry(const char *path, const struct stat *, int, struct FTW *)
+{
+    return remove(path);
+}
+
+}
+
+
+extern "C"
+{
+
+hdfsFS
+hdfsConnectAsUserNewInstance(const char *, tPort, const char *user)
+{
+    if (!Enter(-1)) {return NULL;}
+    MockFS *fs = new MockFS();
+    fs->m_user = user ? user : "nobody";
+    return reinterpret_cast<hdfsFS>(fs);
+}
+
+
+int
+hdfsDisconnect(hdfsFS fs)
+{
+    delete reinterpret_cast<MockFS *>(fs);
+    return 0;
+}
+
+
+hdfsFileInfo *
+hdfsGetPathInfo(hdfsFS fs, const char *path)
+{
+    if (!Enter(-1)) {return NULL;}
+    struct stat st;
+    if (stat(LocalPath(path).c_str(), &st)) {return NULL;}
+    hdfsFileInfo *info = static_cast<hdfsFileInfo *>(calloc(1, sizeof(hdfsFileInfo)));
+    if (!info) {errno = ENOMEM; return NULL;}
+    if (!FillInfo(path, st, reinterpret_cast<MockFS *>(fs)->m_user.c_str(), *info))
+    {
+        hdfsFreeFileInfo(info, 1);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return info;
+}
+
+
+hdfsFileInfo *
+hdfsListDirectory(hdfsFS fs, const char *path, int *numEntries)
+{
+    *numEntries = 0;
+    if (!Enter(-1)) {return NULL;}
+
+    std::string local = LocalPath(path);
+    DIR *dir = opendir(local.c_str());
+    if (!dir) {return NULL;}
+
+    std::vector<std::string> names;
+    struct dirent *entry;
+    while ((entry = readdir(dir)))
+    {
+        if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
+        {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    // Like libhdfs, an empty directory gives NULL with errno 0.
+    errno = 0;
+    if (names.empty()) {return NULL;}
+
+    hdfsFileInfo *infos = static_cast<hdfsFileInfo *>(calloc(names.size(), sizeof(hdfsFileInfo)));
+    if (!infos) {errno = ENOMEM; return NULL;}
+    std::string prefix = path;
+    if (prefix.empty() || (prefix[prefix.size()-1] != '/')) {prefix += "/";}
+    int count = 0;
+    for (size_t idx = 0; idx < names.size(); idx++)
+    {
+        struct stat st;
+        std::string child = prefix + names[idx];
+        if (stat(LocalPath(child.c_str()).c_str(), &st)) {continue;}
+        FillInfo(child.c_str(), st, reinterpret_cast<MockFS *>(fs)->m_user.c_str(), infos[count++]);
+    }
+    *numEntries = count;
+    errno = 0;
+    return infos;
+}
+
+
+void
+hdfsFreeFileInfo(hdfsFileInfo *infos, int numEntries)
+{
+    if (!infos) {return;}
+    for (int idx = 0; idx < numEntries; idx++)
+    {
+        free(infos[idx].mName);
+        free(infos[idx].mOwner);
+        free(infos[idx].mGroup);
+    }
+    free(infos);
+}
+
+
+int
+hdfsExists(hdfsFS, const char *path)
+{
+    if (!Enter(-1)) {return -1;}
+    struct stat st;
+    return stat(LocalPath(path).c_str(), &st) ? -1 : 0;
+}
+
+
+int
+hdfsCreateDirectory(hdfsFS, const char *path)
+{
+    if (!Enter(-1)) {return -1;}
+    // Like HDFS mkdirs, create missing parents and accept existing ones.
+    std::string local = LocalPath(path);
+    for (size_t pos = GetSettings().m_root.size() + 1; pos <= local.size(); pos++)
+    {
+        if ((pos == local.size()) || (local[pos] == '/'))
+        {
+            if (mkdir(local.substr(0, pos).c_str(), 0755) && (errno != EEXIST)) {return -1;}
+        }
+    }
+    return 0;
+}
+
+
+int
+hdfsChmod(hdfsFS, const char *path, short mode)
+{
+    if (!Enter(-1)) {return -1;}
+    return chmod(LocalPath(path).c_str(), mode);
+}
+
+
+int
+hdfsDelete(hdfsFS, const char *path, int recursive)
+{
+    if (!Enter(-1)) {return -1;}
+    std::string local = LocalPath(path);
+    struct stat st;
+    if (lstat(local.c_str(), &st)) {return -1;}
+    if (!S_ISDIR(st.st_mode)) {return unlink(local.c_str());}
+    if (!recursive) {return rmdir(local.c_str());}
+    return nftw(local.c_str(), RemoveEntry, 16, FTW_DEPTH|FTW_PHYS);
+}
+
+
+int
+hdfsRename(hdfsFS, const char *oldPath, const char *newPath)
+{
+    if (!Enter(-1)) {return -1;}
+    return rename(LocalPath(oldPath).c_str(), LocalPath(newPath).c_str());
+}
+
+
+hdfsFile
+hdfsOpenFile(hdfsFS, const char *path, int flags, int, short, tSize)
+{
+    if (!Enter(-1)) {return NULL;}
+    // HDFS files are either read, or written from scratch.
+    int local_flags = (flags & O_WRONLY) ? (O_WRONLY|O_CREAT|O_TRUNC) : O_RDONLY;
+    int fd = open(LocalPath(path).c_str(), local_flags, 0644);
+    if (fd < 0) {return NULL;}
+
+    struct stat st;
+    if (fstat(fd, &st) || S_ISDIR(st.st_mode))
+    {
+        close(fd);
+        errno = EISDIR;
+        return NULL;
+    }
+    MockFile *file = new MockFile();
+    file->m_fd = fd;
+    return reinterpret_cast<hdfsFile>(file);
+}
+
+
+int
+hdfsCloseFile(hdfsFS, hdfsFile file)
+{
+    MockFile *mock = reinterpret_cast<MockFile *>(file);
+    if (!Enter(-1))
+    {
+        int saved_errno = errno;
+        close(mock->m_fd);
+        delete mock;
+        errno = saved_errno;
+        return -1;
+    }
+    int rc = close(mock->m_fd);
+    delete mock;
+    return rc;
+}
+
+
+int
+hdfsAvailable(hdfsFS, hdfsFile file)
+{
+    // Reads are positional, so the stream never moves from the start.
+    struct stat st;
+    if (fstat(reinterpret_cast<MockFile *>(file)->m_fd, &st)) {return -1;}
+    return (st.st_size > INT_MAX) ? INT_MAX : st.st_size;
+}
+
+
+tSize
+hdfsPread(hdfsFS, hdfsFile file, tOffset position, void *buffer, tSize length)
+{
+    if (!Enter(length)) {return -1;}
+    return pread(reinterpret_cast<MockFile *>(file)->m_fd, buffer, length, position);
+}
+
+
+tSize
+hdfsWrite(hdfsFS, hdfsFile file, const void *buffer, tSize length)
+{
+    if (!Enter(length)) {return -1;}
+    const char *data = static_cast<const char *>(buffer);
+    tSize written = 0;
+    while (written < length)
+    {
+        ssize_t rc = write(reinterpret_cast<MockFile *>(file)->m_fd, data + written, length - written);
+        if (rc < 0)
+        {
+            if (errno == EINTR) {continue;}
+            return -1;
+        }
+        written += rc;
+    }
+    return written;
+}
+
+}
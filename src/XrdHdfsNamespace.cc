@@ -0,0 +1,143 @@
+
+#include "XrdHdfsNamespace.hh"
+
+#include <string.h>
+
+#include "XrdHdfsConnPool.hh"
+
+using namespace XrdHdfs;
+
+
+NamespaceMap::NamespaceMap(unsigned per_user, size_t max_users, unsigned idle_secs)
+    : m_per_user(per_user),
+      m_max_users(max_users),
+      m_idle_secs(idle_secs)
+{
+    Add("", "default");
+}
+
+
+NamespaceMap::~NamespaceMap()
+{
+    for (std::vector<Namespace>::iterator iter = m_namespaces.begin();
+         iter != m_namespaces.end(); ++iter)
+    {
+        delete iter->m_pool;
+    }
+}
+
+
+void
+NamespaceMap::Add(const std::string &prefix, const std::string &namenode)
+{
+    Namespace ns;
+    ns.m_prefix = prefix;
+    while ((ns.m_prefix.size() > 1) && (ns.m_prefix[ns.m_prefix.size()-1] == '/'))
+    {
+        ns.m_prefix.erase(ns.m_prefix.size()-1);
+    }
+    ns.m_namenode = namenode;
+    ns.m_pool = new ConnectionPool(namenode, m_per_user, m_max_users, m_idle_secs);
+    m_namespaces.push_back(ns);
+}
+
+
+const NamespaceMap::Namespace &
+NamespaceMap::Route(const char *path) const
+{
+    const Namespace *best = &m_namespaces[0];
+    size_t best_len = 0;
+    for (std::vector<Namespace>::const_iterator iter = m_namespaces.begin() + 1;
+         iter != m_namespaces.end(); ++iter)
+    {
+        size_t len = iter->m_prefix.size();
+        if ((len <= best_len) || strncmp(path, iter->m_prefix.c_str(), len)) {continue;}
+        // "/store" covers "/store" and "/store/x", but not "/storex".
+        if ((path[len] != '\0') && (path[len] != '/') && (iter->m_prefix != "/")) {continue;}
+        best = &*iter;
+        best_len = len;
+    }
+    return *best;
+}
+
+
+hdfsFS
+NamespaceMap::Acquire(const char *path, const std::string &user)
+{
+    return Route(path).m_pool->Acquire(user);
+}
+
+
+void
+NamespaceMap::Release(hdfsFS fs)
+{
+    for (std::vector<Namespace>::iterator iter = m_namespaces.begin();
+         iter != m_namespaces.end(); ++iter)
+    {
+        if (iter->m_pool->Release(fs)) {return;}
+    }
+}
+
+
+void
+NamespaceMap::Sweep()
+{
+    for (std::vector<Namespace>::iterator iter = m_namespaces.begin();
+         iter != m_namespaces.end(); ++iter)
+    {
+        iter->m_pool->MaybeSweep();
+    }
+}
+
+
+const std::string &
+NamespaceMap::NameNode(const char *path) const
+{
+    return Route(path).m_namenode;
+}
+
+
+bool
+NamespaceMap::SameNamespace(const char *path1, const char *path2) const
+{
+    return &Route(path1) == &Route(path2);
+}
+
+
+size_t
+NamespaceMap::Users() const
+{
+    size_t total = 0;
+    for (std::vector<Namespace>::const_iterator iter = m_namespaces.begin();
+         iter != m_namespaces.end(); ++iter)
+    {
+        total += iter->m_pool->Users();
+    }
+    return total;
+}
+
+
+size_t
+NamespaceMap::Connections() const
+{
+    size_t total = 0;
+    for (std::vector<Namespace>::const_iterator iter = m_namespaces.begin();
+         iter != m_namespaces.end(); ++iter)
+    {
+        total += iter->m_pool->Connections();
+    }
+    return total;
+}
+
+
+unsigned long long
+NamespaceMap::Evictions() const
+{
+    unsigned long long total = 0;
+    for (std::vector<Namespace>::const_iterator iter = m_namespaces.begin();
+         iter != m_namespaces.end(); ++iter)
+    {
+        total += iter->m_pool->Evictions();
+    }
+    return total;
+}
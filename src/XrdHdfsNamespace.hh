@@ -0,0 +1,84 @@
+
+/*
+ * Routing of paths to HDFS federation namespaces.
+ */
+
+#ifndef __XRDHDFS_NAMESPACE_H__
+#define __XRDHDFS_NAMESPACE_H__
+
+#include <string>
+#include <vector>
+
+#include "hdfs.h"
+
+namespace XrdHdfs {
+
+class ConnectionPool;
+
+/*
+ * Maps physical paths to the namenode serving them, each with its own pool
+ * of connections.
+ *
+ * With HDFS federation, separate namespaces (say, for data, user areas and
+ * checksums) live on separate namenodes.  Each namespace is registered with
+ * the path prefix it serves; a path belongs to the namespace with the longest
+ * prefix matching it on a path component boundary, and anything unmatched to
+ * the default filesystem of the Hadoop configuration.  Paths are passed to
+ * libhdfs unchanged.
+ *
+ * All namespaces must be added before the map is used.
+ */
+class NamespaceMap
+{
+public:
+    // Pool settings apply to each namespace separately.
+    NamespaceMap(unsigned per_user, size_t max_users, unsigned idle_secs);
+    ~NamespaceMap();
+
+    void Add(const std::string &prefix, const std::string &namenode);
+
+    // Connect to the namespace of `path` as `user`; NULL with errno set on
+    // failure.  Each successful Acquire must be paired with a Release.
+    hdfsFS Acquire(const char *path, const std::string &user);
+
+    void Release(hdfsFS fs);
+
+    // Evict idle users from every namespace's pool, if due.
+    void Sweep();
+
+    // The namenode serving `path`.
+    const std::string &NameNode(const char *path) const;
+
+    // True if `path1` and `path2` are in the same namespace.
+    bool SameNamespace(const char *path1, const char *path2) const;
+
+    // Totals over all namespaces.
+    size_t Namespaces() const {return m_namespaces.size();}
+    size_t Users() const;
+    size_t Connections() const;
+    unsigned long long Evictions() const;
+
+private:
+    NamespaceMap(NamespaceMap const &);
+    NamespaceMap & operator=(NamespaceMap const &);
+
+    struct Namespace
+    {
+        std::string m_prefix;
+        std::string m_namenode;
+        ConnectionPool *m_pool;
+    };
+
+    const Namespace &Route(const char *path) const;
+
+    const unsigned m_per_user;
+    const size_t m_max_users;
+    const unsigned m_idle_secs;
+
+    // The default filesystem comes first; others follow in the order added.
+    std::vector<Namespace> m_namespaces;
+};
+
+}
+
+#endif
@@ -0,0 +1,579 @@
+
+/*
+ * Replays a trace of client operations against the Xrootd HDFS plugin.
+ *
+ * Loads libXrdHdfsReal in-process (see XrdHdfsHarness.hh) and issues the
+ * traced operations against it: each client in the trace gets its own
+ * thread and runs its operations in order, each at its original offset from
+ * the start of the trace, so the concurrency and pacing of production are
+ * reproduced.  The trace is text, one operation per line:
+ *
+ *     <seconds> <client> open <fid> <path> [r|w]
+ *     <seconds> <client> read <fid> <offset> <length>
+ *     <seconds> <client> readv <fid> <offset>:<length>[,<offset>:<length>...]
+ *     <seconds> <client> write <fid> <offset> <length>
+ *     <seconds> <client> close <fid>
+ *     <seconds> <client> stat <path>
+ *     <seconds> <client> opendir <path>
+ *
+ * Times may start anywhere; client and file ids are any tokens, file ids
+ * being local to their client.  Blank lines and lines starting with '#' are
+ * skipped.  Such traces are straightforward to produce from the xrootd
+ * monitoring stream, whose file open, read, readv and close records carry
+ * the same information.
+ *
+ * Prints one JSON object per operation type, then a summary, on stdout:
+ *
+ *     {"op":"read","count":...,"errors":...,"bytes":...,"p50_us":...,
+ *      "p90_us":...,"p99_us":...,"max_us":...}
+ *     {"op":"total","count":...,"errors":...,"bytes":...,"seconds":...,
+ *      "trace_seconds":...,"clients":...,"late_p50_ms":...,"late_p99_ms":...}
+ *
+ * where "late" is how far behind its traced time each operation started.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "XrdOss/XrdOss.hh"
+#include "XrdOuc/XrdOucEnv.hh"
+#include "XrdOuc/XrdOucIOVec.hh"
+
+#include "XrdHdfsHarness.hh"
+
+namespace
+{
+
+enum OpType
+{
+    OpOpen,
+    OpRead,
+    OpReadV,
+    OpWrite,
+    OpClose,
+    OpStat,
+    OpOpendir,
+    OpCount
+};
+
+const char *g_op_names[OpCount] = {"open", "read", "readv", "write", "close", "stat", "opendir"};
+
+struct Chunk
+{
+    long long m_offset;
+    int m_length;
+};
+
+struct Op
+{
+    double m_time;
+    OpType m_type;
+    std::string m_fid;
+    std::string m_path;
+    bool m_write;
+    std::vector<Chunk> m_chunks;
+};
+
+struct OpStats
+{
+    OpStats() : m_count(0), m_errors(0), m_bytes(0) {}
+
+    unsigned long long m_count;
+    unsigned long long m_errors;
+    unsigned long long m_bytes;
+    std::vector<float> m_latencies_us;
+};
+
+struct Client
+{
+    std::string m_name;
+    std::vector<Op> m_ops;
+
+    XrdOss *m_oss;
+    double m_start;
+    double m_speed;
+
+    OpStats m_stats[OpCount];
+    std::vector<float> m_late_ms;
+};
+
+
+double
+Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+void
+SleepUntil(double when)
+{
+    double delay = when - Now();
+    if (delay <= 0) {return;}
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(delay);
+    ts.tv_nsec = static_cast<long>((delay - ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) && (errno == EINTR)) {}
+}
+
+
+bool
+ParseChunk(const std::string &token, Chunk &chunk)
+{
+    char *end;
+    chunk.m_offset = strtoll(token.c_str(), &end, 10);
+    if (*end != ':') {return false;}
+    chunk.m_length = strtol(end + 1, &end, 10);
+    return !*end && (chunk.m_offset >= 0) && (chunk.m_length >= 0);
+}
+
+
+// Parse one trace line into `op` and its client; returns false with `error`
+// set for a malformed line.
+bool
+ParseLine(const std::string &line, Op &op, std::string &client, std::string &error)
+{
+    std::istringstream in(line);
+    std::string type;
+    if (!(in >> op.m_time >> client >> type)) {error = "expected <seconds> <client> <op>"; return false;}
+
+    op.m_write = false;
+    op.m_chunks.clear();
+    Chunk chunk;
+    std::string extra;
+    if (type == "open")
+    {
+        op.m_type = OpOpen;
+        std::string mode;
+        if (!(in >> op.m_fid >> op.m_path)) {error = "expected open <fid> <path>"; return false;}
+        if ((in >> mode) && (mode != "r"))
+        {
+            if (mode != "w") {error = "open mode must be r or w"; return false;}
+            op.m_write = true;
+        }
+    }
+    else if ((type == "read") || (type == "write"))
+    {
+        op.m_type = (type == "read") ? OpRead : OpWrite;
+        if (!(in >> op.m_fid >> chunk.m_offset >> chunk.m_length) || (chunk.m_offset < 0) || (chunk.m_length < 0))
+        {
+            error = "expected " + type + " <fid> <offset> <length>";
+            return false;
+        }
+        op.m_chunks.push_back(chunk);
+    }
+    else if (type == "readv")
+    {
+        op.m_type = OpReadV;
+        std::string list;
+        if (!(in >> op.m_fid >> list)) {error = "expected readv <fid> <offset>:<length>,..."; return false;}
+        std::istringstream chunks(list);
+        std::string token;
+        while (std::getline(chunks, token, ','))
+        {
+            if (!ParseChunk(token, chunk)) {error = "bad readv element " + token; return false;}
+            op.m_chunks.push_back(chunk);
+        }
+        if (op.m_chunks.empty()) {error = "empty readv"; return false;}
+    }
+    else if (type == "close")
+    {
+        op.m_type = OpClose;
+        if (!(in >> op.m_fid)) {error = "expected close <fid>"; return false;}
+    }
+    else if ((type == "stat") || (type == "opendir"))
+    {
+        op.m_type = (type == "stat") ? OpStat : OpOpendir;
+        if (!(in >> op.m_path)) {error = "expected " + type + " <path>"; return false;}
+    }
+    else
+    {
+        error = "unknown operation " + type;
+        return false;
+    }
+    if (in >> extra) {error = "trailing " + extra; return false;}
+    return true;
+}
+
+
+int
+LoadTrace(const char *fname, std::vector<Client> &clients, double &first, double &last)
+{
+    FILE *fp = strcmp(fname, "-") ? fopen(fname, "r") : stdin;
+    if (!fp)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", fname, strerror(errno));
+        return 1;
+    }
+
+    std::map<std::string, size_t> index;
+    first = last = 0;
+    bool empty = true;
+    char *buffer = NULL;
+    size_t buffer_size = 0;
+    unsigned lineno = 0;
+    ssize_t len;
+    while ((len = getline(&buffer, &buffer_size, fp)) >= 0)
+    {
+        lineno++;
+        std::string line(buffer, len);
+        size_t start = line.find_first_not_of(" \t\r\n");
+        if ((start == std::string::npos) || (line[start] == '#')) {continue;}
+
+        Op op;
+        std::string client, error;
+        if (!ParseLine(line, op, client, error))
+        {
+            fprintf(stderr, "%s:%u: %s\n", fname, lineno, error.c_str());
+            free(buffer);
+            if (fp != stdin) {fclose(fp);}
+            return 1;
+        }
+        if (empty || (op.m_time < first)) {first = op.m_time;}
+        if (empty || (op.m_time > last)) {last = op.m_time;}
+        empty = false;
+
+        std::map<std::string, size_t>::iterator iter = index.find(client);
+        if (iter == index.end())
+        {
+            iter = index.insert(std::make_pair(client, clients.size())).first;
+            clients.push_back(Client());
+            clients.back().m_name = client;
+        }
+        clients[iter->second].m_ops.push_back(op);
+    }
+    free(buffer);
+    if (fp != stdin) {fclose(fp);}
+
+    // Traces merged from several sources need not be in order.
+    for (size_t idx = 0; idx < clients.size(); idx++)
+    {
+        std::vector<Op> &ops = clients[idx].m_ops;
+        for (size_t oidx = 0; oidx < ops.size(); oidx++) {ops[oidx].m_time -= first;}
+        std::stable_sort(ops.begin(), ops.end(),
+                         [](const Op &left, const Op &right) {return left.m_time < right.m_time;});
+    }
+    return 0;
+}
+
+
+// Give the mock what the trace expects to find: every directory listed or
+// written into and every file read, large enough for the reads made of it.
+// Files are sparse.
+int
+Populate(const std::string &root, const std::vector<Client> &clients)
+{
+    std::map<std::string, long long> files;
+    std::vector<std::string> dirs;
+    for (size_t idx = 0; idx < clients.size(); idx++)
+    {
+        std::map<std::string, std::string> open_paths;
+        const std::vector<Op> &ops = clients[idx].m_ops;
+        for (size_t oidx = 0; oidx < ops.size(); oidx++)
+        {
+            const Op &op = ops[oidx];
+            if (op.m_type == OpOpendir) {dirs.push_back(op.m_path);}
+            if ((op.m_type == OpOpen) && op.m_write) {dirs.push_back(op.m_path.substr(0, op.m_path.rfind('/')));}
+            if ((op.m_type == OpOpen) && !op.m_write)
+            {
+                open_paths[op.m_fid] = op.m_path;
+                files.insert(std::make_pair(op.m_path, 0LL));
+            }
+            if ((op.m_type == OpRead) || (op.m_type == OpReadV))
+            {
+                std::map<std::string, std::string>::const_iterator path = open_paths.find(op.m_fid);
+                if (path == open_paths.end()) {continue;}
+                long long &size = files[path->second];
+                for (size_t cidx = 0; cidx < op.m_chunks.size(); cidx++)
+                {
+                    size = std::max(size, op.m_chunks[cidx].m_offset + op.m_chunks[cidx].m_length);
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> parents(dirs);
+    for (std::map<std::string, long long>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+    {
+        parents.push_back(iter->first.substr(0, iter->first.rfind('/')));
+    }
+    for (size_t idx = 0; idx < parents.size(); idx++)
+    {
+        std::string local = root + parents[idx];
+        for (size_t pos = root.size() + 1; pos <= local.size(); pos++)
+        {
+            if ((pos == local.size()) || (local[pos] == '/'))
+            {
+                if (mkdir(local.substr(0, pos).c_str(), 0755) && (errno != EEXIST))
+                {
+                    fprintf(stderr, "Failed to create %s: %s\n", local.substr(0, pos).c_str(), strerror(errno));
+                    return 1;
+                }
+            }
+        }
+    }
+    for (std::map<std::string, long long>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+    {
+        std::string local = root + iter->first;
+        struct stat st;
+        int fd = open(local.c_str(), O_WRONLY|O_CREAT, 0644);
+        if ((fd < 0) || fstat(fd, &st) || ((st.st_size < iter->second) && ftruncate(fd, iter->second)))
+        {
+            fprintf(stderr, "Failed to create %s: %s\n", local.c_str(), strerror(errno));
+            if (fd >= 0) {close(fd);}
+            return 1;
+        }
+        close(fd);
+    }
+    return 0;
+}
+
+
+// Run one operation; returns the bytes moved, or -errno.
+long long
+Execute(XrdOss &oss, XrdOucEnv &env, const Op &op, std::map<std::string, XrdOssDF *> &files,
+        std::vector<char> &buffer)
+{
+    std::map<std::string, XrdOssDF *>::iterator file = files.find(op.m_fid);
+    switch (op.m_type)
+    {
+    case OpOpen:
+    {
+        if (file != files.end()) {return -EBADF;}
+        XrdOssDF *fp = oss.newFile("replay");
+        int rc = op.m_write ? fp->Open(op.m_path.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644, env)
+                            : fp->Open(op.m_path.c_str(), O_RDONLY, 0, env);
+        if (rc) {delete fp; return rc;}
+        files[op.m_fid] = fp;
+        return 0;
+    }
+    case OpRead:
+    case OpWrite:
+    {
+        if (file == files.end()) {return -EBADF;}
+        const Chunk &chunk = op.m_chunks[0];
+        if (buffer.size() < static_cast<size_t>(chunk.m_length)) {buffer.resize(chunk.m_length);}
+        return (op.m_type == OpRead) ? file->second->Read(&buffer[0], chunk.m_offset, chunk.m_length)
+                                     : file->second->Write(&buffer[0], chunk.m_offset, chunk.m_length);
+    }
+    case OpReadV:
+    {
+        if (file == files.end()) {return -EBADF;}
+        size_t total = 0;
+        for (size_t idx = 0; idx < op.m_chunks.size(); idx++) {total += op.m_chunks[idx].m_length;}
+        if (buffer.size() < total) {buffer.resize(total);}
+        std::vector<XrdOucIOVec> iov(op.m_chunks.size());
+        size_t position = 0;
+        for (size_t idx = 0; idx < op.m_chunks.size(); idx++)
+        {
+            iov[idx].offset = op.m_chunks[idx].m_offset;
+            iov[idx].size = op.m_chunks[idx].m_length;
+            iov[idx].info = 0;
+            iov[idx].data = &buffer[position];
+            position += op.m_chunks[idx].m_length;
+        }
+        return file->second->ReadV(&iov[0], iov.size());
+    }
+    case OpClose:
+    {
+        if (file == files.end()) {return -EBADF;}
+        int rc = file->second->Close();
+        delete file->second;
+        files.erase(file);
+        return rc;
+    }
+    case OpStat:
+    {
+        struct stat st;
+        return oss.Stat(op.m_path.c_str(), &st, 0, &env);
+    }
+    case OpOpendir:
+    {
+        XrdOssDF *dir = oss.newDir("replay");
+        int rc = dir->Opendir(op.m_path.c_str(), env);
+        if (!rc)
+        {
+            char entry[1024];
+            while (!(rc = dir->Readdir(entry, sizeof(entry))) && *entry) {}
+            dir->Close();
+        }
+        delete dir;
+        return rc;
+    }
+    case OpCount:
+        break;
+    }
+    return -EINVAL;
+}
+
+
+void *
+RunClient(void *arg)
+{
+    Client &client = *static_cast<Client *>(arg);
+    XrdOucEnv env;
+    std::map<std::string, XrdOssDF *> files;
+    std::vector<char> buffer;
+
+    for (size_t idx = 0; idx < client.m_ops.size(); idx++)
+    {
+        const Op &op = client.m_ops[idx];
+        double scheduled = client.m_start + (client.m_speed > 0 ? op.m_time / client.m_speed : 0);
+        SleepUntil(scheduled);
+
+        double start = Now();
+        long long result = Execute(*client.m_oss, env, op, files, buffer);
+        double end = Now();
+
+        OpStats &stats = client.m_stats[op.m_type];
+        stats.m_count++;
+        stats.m_latencies_us.push_back((end - start) * 1e6);
+        if (client.m_speed > 0) {client.m_late_ms.push_back((start - scheduled) * 1e3);}
+        if (result < 0) {stats.m_errors++;}
+        else {stats.m_bytes += result;}
+    }
+
+    // Traces cut off mid-session leave files open.
+    for (std::map<std::string, XrdOssDF *>::iterator iter = files.begin(); iter != files.end(); ++iter)
+    {
+        iter->second->Close();
+        delete iter->second;
+    }
+    return NULL;
+}
+
+
+float
+Percentile(const std::vector<float> &sorted, double fraction)
+{
+    if (sorted.empty()) {return 0;}
+    return sorted[static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5)];
+}
+
+
+void
+Usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-c config] [-l plugin] [-m mock] [-D directive] [-x speed] [-N] trace\n"
+        "\n"
+        "  -c  xrootd configuration to initialize the plugin with; by default\n"
+        "      the mock libhdfs is used, over a temporary directory populated\n"
+        "      with the files and directories the trace reads.\n"
+        "  -l  libXrdHdfsReal to load (default: next to this program).\n"
+        "  -m  libXrdHdfsMock to use (default: next to this program).\n"
+        "  -D  extra directive for the generated configuration; repeatable.\n"
+        "  -x  replay speed relative to the trace (1); 2 replays twice as fast.\n"
+        "  -N  no pacing: each client issues its operations back to back.\n"
+        "\n"
+        "A trace of '-' is read from stdin.\n",
+        prog);
+}
+
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    XrdHdfs::Harness harness;
+    double speed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:l:m:D:x:Nh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c': harness.m_config = optarg; break;
+        case 'l': harness.m_plugin = optarg; break;
+        case 'm': harness.m_mock = optarg; break;
+        case 'D': harness.m_directives += std::string(optarg) + "\n"; break;
+        case 'x': speed = strtod(optarg, NULL); break;
+        case 'N': speed = 0; break;
+        default:
+            Usage(argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if ((optind != argc - 1) || (speed < 0)) {Usage(argv[0]); return 2;}
+
+    std::vector<Client> clients;
+    double first, last;
+    if (LoadTrace(argv[optind], clients, first, last)) {return 1;}
+
+    std::string error;
+    XrdOss *oss = harness.Load(error);
+    if (!oss)
+    {
+        fprintf(stderr, "Failed to load the plugin: %s\n", error.c_str());
+        return 1;
+    }
+    if (!harness.MockRoot().empty() && Populate(harness.MockRoot(), clients)) {return 1;}
+
+    std::vector<pthread_t> tids(clients.size());
+    double start = Now();
+    for (size_t idx = 0; idx < clients.size(); idx++)
+    {
+        clients[idx].m_oss = oss;
+        clients[idx].m_start = start;
+        clients[idx].m_speed = speed;
+        if (pthread_create(&tids[idx], NULL, RunClient, &clients[idx]))
+        {
+            fprintf(stderr, "Failed to start the thread of client %s\n", clients[idx].m_name.c_str());
+            return 1;
+        }
+    }
+    for (size_t idx = 0; idx < clients.size(); idx++) {pthread_join(tids[idx], NULL);}
+    double seconds = Now() - start;
+
+    OpStats total;
+    std::vector<float> late_ms;
+    for (int type = 0; type < OpCount; type++)
+    {
+        OpStats stats;
+        for (size_t idx = 0; idx < clients.size(); idx++)
+        {
+            const OpStats &client = clients[idx].m_stats[type];
+            stats.m_count += client.m_count;
+            stats.m_errors += client.m_errors;
+            stats.m_bytes += client.m_bytes;
+            stats.m_latencies_us.insert(stats.m_latencies_us.end(), client.m_latencies_us.begin(), client.m_latencies_us.end());
+        }
+        if (!stats.m_count) {continue;}
+        total.m_count += stats.m_count;
+        total.m_errors += stats.m_errors;
+        total.m_bytes += stats.m_bytes;
+
+        std::sort(stats.m_latencies_us.begin(), stats.m_latencies_us.end());
+        printf("{\"op\":\"%s\",\"count\":%llu,\"errors\":%llu,\"bytes\":%llu,"
+               "\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+               g_op_names[type], stats.m_count, stats.m_errors, stats.m_bytes,
+               Percentile(stats.m_latencies_us, 0.5), Percentile(stats.m_latencies_us, 0.9),
+               Percentile(stats.m_latencies_us, 0.99), stats.m_latencies_us.back());
+    }
+    for (size_t idx = 0; idx < clients.size(); idx++)
+    {
+        late_ms.insert(late_ms.end(), clients[idx].m_late_ms.begin(), clients[idx].m_late_ms.end());
+    }
+    std::sort(late_ms.begin(), late_ms.end());
+    printf("{\"op\":\"total\",\"count\":%llu,\"errors\":%llu,\"bytes\":%llu,\"seconds\":%.3f,"
+           "\"trace_seconds\":%.3f,\"clients\":%zu,\"late_p50_ms\":%.2f,\"late_p99_ms\":%.2f}\n",
+           total.m_count, total.m_errors, total.m_bytes, seconds, last - first, clients.size(),
+           Percentile(late_ms, 0.5), Percentile(late_ms, 0.99));
+    return 0;
+}
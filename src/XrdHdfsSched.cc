@@ -0,0 +1,137 @@
+
+#include "XrdHdfsSched.hh"
+
+using namespace XrdHdfs;
+
+
+namespace
+{
+
+__thread OpContext *t_context = NULL;
+
+}
+
+
+Scheduler *XrdHdfs::g_scheduler = NULL;
+
+
+const char *
+XrdHdfs::OpClassName(OpClass cls)
+{
+    switch (cls)
+    {
+    case OpCmsdMeta: return "cmsd";
+    case OpMeta:     return "meta";
+    case OpRead:     return "read";
+    case OpWrite:    return "write";
+    case OpChecksum: return "cksum";
+    default:         return "unknown";
+    }
+}
+
+
+OpContext::OpContext(OpClass cls, const std::string &user)
+    : m_class(cls),
+      m_user(user),
+      m_prev(t_context)
+{
+    t_context = this;
+}
+
+
+OpContext::~OpContext()
+{
+    t_context = m_prev;
+}
+
+
+const OpContext *
+OpContext::Current()
+{
+    return t_context;
+}
+
+
+Scheduler::Scheduler(const unsigned limits[OpClassCount])
+{
+    for (unsigned idx = 0; idx < OpClassCount; idx++)
+    {
+        m_classes[idx].m_limit = limits[idx];
+    }
+}
+
+
+void
+Scheduler::Enter(OpClass cls, const std::string &user)
+{
+    ClassState &state = m_classes[cls];
+    if (!state.m_limit) {return;}
+
+    state.m_mutex.Lock();
+    if (state.m_ring.empty() && (state.m_active < state.m_limit))
+    {
+        state.m_active++;
+        state.m_mutex.UnLock();
+        return;
+    }
+
+    Waiter waiter;
+    std::deque<Waiter *> &queue = state.m_queues[user];
+    if (queue.empty()) {state.m_ring.push_back(user);}
+    queue.push_back(&waiter);
+    state.m_queued++;
+    state.m_waits++;
+    state.m_mutex.UnLock();
+
+    // Leave() hands its slot directly to us, so m_active is already counted.
+    waiter.m_admitted.Wait();
+}
+
+
+void
+Scheduler::Leave(OpClass cls)
+{
+    ClassState &state = m_classes[cls];
+    if (!state.m_limit) {return;}
+
+    state.m_mutex.Lock();
+    if (state.m_ring.empty())
+    {
+        state.m_active--;
+        state.m_mutex.UnLock();
+        return;
+    }
+
+    // Serve the user at the front of the ring, then send them to the back.
+    std::string user = state.m_ring.front();
+    state.m_ring.pop_front();
+    std::unordered_map<std::string, std::deque<Waiter *> >::iterator iter = state.m_queues.find(user);
+    Waiter *waiter = iter->second.front();
+    iter->second.pop_front();
+    if (iter->second.empty()) {state.m_queues.erase(iter);}
+    else {state.m_ring.push_back(user);}
+    state.m_queued--;
+    state.m_mutex.UnLock();
+
+    waiter->m_admitted.Post();
+}
+
+
+Scheduler::Slot::Slot(Scheduler *sched)
+    : m_sched(NULL),
+      m_class(OpMeta)
+{
+    const OpContext *context = OpContext::Current();
+    if (sched && context)
+    {
+        m_sched = sched;
+        m_class = context->m_class;
+        m_sched->Enter(m_class, context->m_user);
+    }
+}
+
+
+Scheduler::Slot::~Slot()
+{
+    if (m_sched) {m_sched->Leave(m_class);}
+}
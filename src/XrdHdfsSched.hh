@@ -0,0 +1,133 @@
+
+/*
+ * Admission control for the libhdfs calls made by the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_SCHED_H__
+#define __XRDHDFS_SCHED_H__
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace XrdHdfs {
+
+// The kinds of work the plugin does; each is scheduled separately.
+enum OpClass
+{
+    OpCmsdMeta = 0, // Existence probes from the cmsd.
+    OpMeta,         // Namespace operations on behalf of clients.
+    OpRead,         // Data reads.
+    OpWrite,        // Data writes.
+    OpChecksum,     // Reads made to compute checksums.
+    OpClassCount
+};
+
+const char *OpClassName(OpClass cls);
+
+/*
+ * What the current thread is doing, and for whom.
+ *
+ * Each entry point of the plugin declares one of these for its duration; the
+ * libhdfs call wrappers consult it to decide how to schedule each call.
+ * Contexts nest; the innermost one applies.
+ */
+class OpContext
+{
+public:
+    OpContext(OpClass cls, const std::string &user);
+    ~OpContext();
+
+    // The innermost context of the calling thread, or NULL.
+    static const OpContext *Current();
+
+    const OpClass m_class;
+    const std::string m_user;
+
+private:
+    OpContext(OpContext const &);
+    OpContext & operator=(OpContext const &);
+
+    OpContext *m_prev;
+};
+
+/*
+ * Limits how many libhdfs calls of each class run at once.
+ *
+ * Without limits, a storm of cmsd stats can occupy every thread talking to
+ * the namenode while data reads queue behind it, and a single user can
+ * saturate the namenode.  Each class has its own concurrency limit (0 for
+ * none), so a burst in one class never delays another.  Within a class,
+ * waiting calls are admitted round-robin across users: a user with a thousand
+ * queued calls gets one admitted per turn, like everyone else.
+ */
+class Scheduler
+{
+public:
+    explicit Scheduler(const unsigned limits[OpClassCount]);
+
+    // Block until a call of class `cls` for `user` may run.
+    void Enter(OpClass cls, const std::string &user);
+
+    // The call admitted by Enter has finished.
+    void Leave(OpClass cls);
+
+    unsigned Limit(OpClass cls) const {return m_classes[cls].m_limit;}
+    unsigned Active(OpClass cls) const {return m_classes[cls].m_active;}
+    unsigned Queued(OpClass cls) const {return m_classes[cls].m_queued;}
+    unsigned long long Waits(OpClass cls) const {return m_classes[cls].m_waits;}
+
+    // Holds an admission for the calling thread's current context, if any.
+    class Slot
+    {
+    public:
+        explicit Slot(Scheduler *sched);
+        ~Slot();
+
+    private:
+        Slot(Slot const &);
+        Slot & operator=(Slot const &);
+
+        Scheduler *m_sched;
+        OpClass m_class;
+    };
+
+private:
+    Scheduler(Scheduler const &);
+    Scheduler & operator=(Scheduler const &);
+
+    struct Waiter
+    {
+        Waiter() : m_admitted(0) {}
+
+        XrdSysSemaphore m_admitted;
+    };
+
+    struct ClassState
+    {
+        ClassState() : m_limit(0), m_active(0), m_queued(0), m_waits(0) {}
+
+        XrdSysMutex m_mutex;
+        unsigned m_limit;
+        std::atomic<unsigned> m_active;
+        std::atomic<unsigned> m_queued;
+        std::atomic<unsigned long long> m_waits;
+
+        // Waiters per user, and the users with waiters in the order in
+        // which they will next be served.
+        std::unordered_map<std::string, std::deque<Waiter *> > m_queues;
+        std::deque<std::string> m_ring;
+    };
+
+    ClassState m_classes[OpClassCount];
+};
+
+// The plugin's scheduler; NULL unless limits are configured.
+extern Scheduler *g_scheduler;
+
+}
+
+#endif
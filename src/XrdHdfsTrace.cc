@@ -0,0 +1,237 @@
+
+#include "XrdHdfsTrace.hh"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "XrdOuc/XrdOucEnv.hh"
+#include "XrdOuc/XrdOucStream.hh"
+#include "XrdOuc/XrdOuca2x.hh"
+#include "XrdSys/XrdSysError.hh"
+#include "XrdSys/XrdSysTimer.hh"
+
+using namespace XrdHdfs;
+
+
+// Messages go through g_trace_log, so OssTrace only holds what is enabled.
+XrdOucTrace XrdHdfs::OssTrace(NULL);
+
+TraceLog *XrdHdfs::g_trace_log = NULL;
+
+
+TraceLog::TraceLog(XrdSysError &log, unsigned rate, size_t capacity)
+    : m_log(log),
+      m_rate(rate),
+      m_capacity(capacity),
+      m_second(0),
+      m_admitted(0),
+      m_dropped(0),
+      m_dropped_reported(0)
+{
+}
+
+
+int
+TraceLog::Start()
+{
+    pthread_t tid;
+    if (XrdSysThread::Run(&tid, EmitMain, static_cast<void *>(this), 0, "HDFS trace"))
+    {
+        return errno ? errno : EAGAIN;
+    }
+    return 0;
+}
+
+
+void *
+TraceLog::EmitMain(void *arg)
+{
+    TraceLog *trace = static_cast<TraceLog *>(arg);
+    while (true)
+    {
+        XrdSysTimer::Wait(100);
+        trace->Emit();
+    }
+    return NULL;
+}
+
+
+void
+TraceLog::Emit()
+{
+    std::vector<std::string> batch;
+    m_mutex.Lock();
+    batch.swap(m_pending);
+    m_mutex.UnLock();
+
+    for (std::vector<std::string>::const_iterator iter = batch.begin(); iter != batch.end(); ++iter)
+    {
+        m_log.Say("hdfs trace ", iter->c_str());
+    }
+
+    unsigned long long dropped = m_dropped;
+    if (dropped != m_dropped_reported)
+    {
+        char count[32];
+        snprintf(count, sizeof(count), "%llu", dropped - m_dropped_reported);
+        m_log.Say("hdfs trace ", count, " messages dropped over the rate limit");
+        m_dropped_reported = dropped;
+    }
+}
+
+
+bool
+TraceLog::Admit()
+{
+    if (!m_rate) {return true;}
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    long long second = m_second.load(std::memory_order_relaxed);
+    if ((now.tv_sec != second) && m_second.compare_exchange_strong(second, now.tv_sec))
+    {
+        m_admitted.store(0, std::memory_order_relaxed);
+    }
+    if (m_admitted.fetch_add(1, std::memory_order_relaxed) < m_rate) {return true;}
+    m_dropped++;
+    return false;
+}
+
+
+void
+TraceLog::Post(const char *epname, const char *msg)
+{
+    std::string line = std::string(epname) + ": " + msg;
+    XrdSysMutexHelper lock(m_mutex);
+    if (m_pending.size() >= m_capacity)
+    {
+        m_dropped++;
+        return;
+    }
+    m_pending.push_back(line);
+}
+
+
+void
+XrdHdfs::TracePost(const char *epname, const char *fmt, ...)
+{
+    // Over the rate limit, skip even the formatting.
+    if (!g_trace_log || !g_trace_log->Admit()) {return;}
+    char msg[1024];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, args);
+    va_end(args);
+    g_trace_log->Post(epname, msg);
+}
+
+
+int
+XrdHdfs::ParseTrace(XrdSysError &log, XrdOucStream &config, int &what, int &rate)
+{
+    static const struct {const char *m_name; int m_value;} events[] =
+    {
+        {"all",    TRACE_ALL},
+        {"off",    0},
+        {"open",   TRACE_Open},
+        {"n2n",    TRACE_N2N},
+        {"cksum",  TRACE_Cksum},
+        {"stats",  TRACE_Stats}
+    };
+    const size_t event_count = sizeof(events)/sizeof(events[0]);
+
+    char *val = config.GetWord();
+    if (!val || !val[0])
+    {
+        log.Emsg("Config", "trace option not specified");
+        return 1;
+    }
+
+    for (; val && val[0]; val = config.GetWord())
+    {
+        if (!strcmp(val, "ratelimit"))
+        {
+            if (!(val = config.GetWord()))
+            {
+                log.Emsg("Config", "trace ratelimit value not specified");
+                return 1;
+            }
+            if (XrdOuca2x::a2i(log, "trace ratelimit", val, &rate, 0)) {return 1;}
+            continue;
+        }
+        if (!strcmp(val, "off"))
+        {
+            what = 0;
+            continue;
+        }
+        bool negate = (val[0] == '-') && val[1];
+        if (negate) {val++;}
+        size_t idx = 0;
+        while ((idx < event_count) && strcmp(val, events[idx].m_name)) {idx++;}
+        if (idx == event_count)
+        {
+            log.Emsg("Config", "invalid trace option", val);
+            return 1;
+        }
+        if (negate) {what &= ~events[idx].m_value;}
+        else {what |= events[idx].m_value;}
+    }
+    return 0;
+}
+
+
+int
+XrdHdfs::ConfigTrace(XrdSysError &log, const char *config_fn)
+{
+    if (!config_fn || !config_fn[0]) {return 0;}
+    int fd = open(config_fn, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        log.Emsg("Config", errno, "open config file", config_fn);
+        return 1;
+    }
+
+    XrdOucEnv env;
+    XrdOucStream config(&log, getenv("XRDINSTANCE"), &env, "=====> ");
+    config.Attach(fd);
+    int what = OssTrace.What, rate = TraceLog::DefaultRate, rc = 0;
+    char *var;
+    while ((var = config.GetMyFirstWord()))
+    {
+        if (!strcmp(var, "oss.trace") && ParseTrace(log, config, what, rate))
+        {
+            config.Echo();
+            rc = 1;
+        }
+    }
+    config.Close();
+    if (rc) {return rc;}
+
+    OssTrace.What = what;
+    if (what && !g_trace_log && (rc = StartTrace(log, rate)))
+    {
+        log.Emsg("Config", rc, "start the trace thread");
+        return 1;
+    }
+    return 0;
+}
+
+
+int
+XrdHdfs::StartTrace(XrdSysError &log, unsigned rate)
+{
+    TraceLog *trace = new TraceLog(log, rate, TraceLog::DefaultCapacity);
+    int rc = trace->Start();
+    if (rc)
+    {
+        delete trace;
+        return rc;
+    }
+    g_trace_log = trace;
+    return 0;
+}
@@ -0,0 +1,105 @@
+
+/*
+ * Tracing for the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_TRACE_H__
+#define __XRDHDFS_TRACE_H__
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "XrdOuc/XrdOucTrace.hh"
+#include "XrdSys/XrdSysPthread.hh"
+
+class XrdOucStream;
+class XrdSysError;
+
+// The events which may be traced; OssTrace.What holds those enabled.
+#define TRACE_Open   0x0001 // Each file opened, with its physical path.
+#define TRACE_N2N    0x0002 // Paths the name translation has no mapping for.
+#define TRACE_Cksum  0x0004 // Checksums looked up.
+#define TRACE_Stats  0x0008 // Read buffer statistics of each file closed.
+#define TRACE_ALL    0x000f
+
+// Trace an event; the message, printf-style, is only formatted if the event
+// is enabled, and is logged asynchronously.
+#define HDFS_TRACE(act, epname, ...) \
+   if (XrdHdfs::OssTrace.What & TRACE_ ## act) XrdHdfs::TracePost(epname, __VA_ARGS__)
+
+namespace XrdHdfs {
+
+extern XrdOucTrace OssTrace;
+
+/*
+ * Emits trace messages from a background thread.
+ *
+ * Logging through XrdSysError takes the logger's lock and writes for each
+ * message, which serializes opens at high rates.  Instead, messages are
+ * queued in memory and written in batches by a thread of their own.  At most
+ * `rate` messages a second are queued (0 for no limit), and at most
+ * `capacity` wait at once; the rest are dropped, and how many is logged.
+ */
+class TraceLog
+{
+public:
+    static const unsigned DefaultRate = 100;
+    static const size_t DefaultCapacity = 10000;
+
+    TraceLog(XrdSysError &log, unsigned rate, size_t capacity);
+
+    // Start the emitting thread; returns 0 or an errno value.
+    int Start();
+
+    // Take a place in this second's allowance of messages; false, counting
+    // the message as dropped, if there is none left.
+    bool Admit();
+
+    // Queue a message admitted by Admit.
+    void Post(const char *epname, const char *msg);
+
+    unsigned long long Dropped() const {return m_dropped;}
+
+private:
+    TraceLog(TraceLog const &);
+    TraceLog & operator=(TraceLog const &);
+
+    static void *EmitMain(void *arg);
+    void Emit();
+
+    XrdSysError &m_log;
+    const unsigned m_rate;
+    const size_t m_capacity;
+
+    std::atomic<long long> m_second;
+    std::atomic<unsigned> m_admitted;
+    std::atomic<unsigned long long> m_dropped;
+    unsigned long long m_dropped_reported;
+
+    XrdSysMutex m_mutex;
+    std::vector<std::string> m_pending;
+};
+
+// The plugin's trace log; NULL unless some event is traced.
+extern TraceLog *g_trace_log;
+
+// Format a message and hand it to g_trace_log; used by HDFS_TRACE.
+void TracePost(const char *epname, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Parse the options of an oss.trace directive, updating `what` (events, as
+// in OssTrace.What) and `rate`.  Returns 0, or 1 after logging the error.
+int ParseTrace(XrdSysError &log, XrdOucStream &config, int &what, int &rate);
+
+// Apply the oss.trace directives of the configuration file `config_fn` and,
+// if any event is traced, start g_trace_log.  For modules which do not see
+// the oss configuration, such as the checksum plugin.  Returns 0 or 1.
+int ConfigTrace(XrdSysError &log, const char *config_fn);
+
+// Start g_trace_log with the given rate; returns 0 or an errno value.
+int StartTrace(XrdSysError &log, unsigned rate);
+
+}
+
+#endif
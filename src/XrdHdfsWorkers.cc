@@ -0,0 +1,95 @@
+
+#include "XrdHdfsWorkers.hh"
+
+using namespace XrdHdfs;
+
+
+namespace
+{
+
+// Set on worker threads, so nested calls do not queue behind themselves.
+__thread bool t_is_worker = false;
+
+}
+
+
+JniWorkers *XrdHdfs::g_jni_workers = NULL;
+
+
+JniWorkers::JniWorkers(unsigned count)
+    : m_count(count ? count : 1),
+      m_cond(0),
+      m_head(NULL),
+      m_tail(NULL),
+      m_calls(0)
+{
+}
+
+
+int
+JniWorkers::Start()
+{
+    for (unsigned idx = 0; idx < m_count; idx++)
+    {
+        pthread_t tid;
+        if (XrdSysThread::Run(&tid, WorkerMain, static_cast<void *>(this), 0, "HDFS JNI worker"))
+        {
+            return errno ? errno : EAGAIN;
+        }
+    }
+    return 0;
+}
+
+
+void *
+JniWorkers::WorkerMain(void *arg)
+{
+    t_is_worker = true;
+    static_cast<JniWorkers *>(arg)->Work();
+    return NULL;
+}
+
+
+void
+JniWorkers::Work()
+{
+    while (true)
+    {
+        m_cond.Lock();
+        while (!m_head) {m_cond.Wait();}
+        Job *job = m_head;
+        m_head = job->m_next;
+        if (!m_head) {m_tail = NULL;}
+        m_cond.UnLock();
+
+        errno = job->m_errno;
+        job->Run();
+        job->m_errno = errno;
+        job->m_done.Post();
+    }
+}
+
+
+void
+JniWorkers::Execute(Job &job)
+{
+    if (t_is_worker)
+    {
+        job.Run();
+        return;
+    }
+
+    job.m_errno = errno;
+    job.m_next = NULL;
+
+    m_cond.Lock();
+    if (m_tail) {m_tail->m_next = &job;}
+    else {m_head = &job;}
+    m_tail = &job;
+    m_calls++;
+    m_cond.Signal();
+    m_cond.UnLock();
+
+    job.m_done.Wait();
+    errno = job.m_errno;
+}
@@ -0,0 +1,103 @@
+
+/*
+ * Dedicated JNI worker threads for the Xrootd HDFS plugin.
+ */
+
+#ifndef __XRDHDFS_WORKERS_H__
+#define __XRDHDFS_WORKERS_H__
+
+#include <errno.h>
+
+#include <atomic>
+
+#include "XrdSys/XrdSysPthread.hh"
+
+namespace XrdHdfs {
+
+/*
+ * A fixed pool of threads which make all libhdfs calls on behalf of others.
+ *
+ * libhdfs attaches every thread that calls it to the JVM and keeps a JNIEnv
+ * (and a Java Thread object) for it.  With xrootd's elastic thread pool this
+ * means attach churn and an unbounded number of Java threads.  When workers
+ * are enabled, callers hand each libhdfs call to this pool and block until it
+ * has run; only the workers are ever attached, each on its first call.
+ *
+ * errno is carried to the worker before the call and back afterwards, so
+ * callers can treat a dispatched call exactly like a direct one.
+ */
+class JniWorkers
+{
+public:
+    explicit JniWorkers(unsigned count);
+
+    // Start the threads; returns 0 or an errno value.
+    int Start();
+
+    class Job
+    {
+    public:
+        Job() : m_done(0), m_errno(0), m_next(NULL) {}
+        virtual ~Job() {}
+
+        virtual void Run() = 0;
+
+    private:
+        friend class JniWorkers;
+
+        XrdSysSemaphore m_done;
+        int m_errno;
+        Job *m_next;
+    };
+
+    // Run `job` on a worker and wait for it to finish.  Called from a worker
+    // thread, the job simply runs inline.
+    void Execute(Job &job);
+
+    unsigned long long Calls() const {return m_calls;}
+
+private:
+    JniWorkers(JniWorkers const &);
+    JniWorkers & operator=(JniWorkers const &);
+
+    static void *WorkerMain(void *);
+    void Work();
+
+    const unsigned m_count;
+
+    XrdSysCondVar m_cond;
+    Job *m_head;
+    Job *m_tail;
+
+    std::atomic<unsigned long long> m_calls;
+};
+
+// The plugin's worker pool; NULL unless workers are enabled.
+extern JniWorkers *g_jni_workers;
+
+template <typename Fn, typename Result>
+class CallJob : public JniWorkers::Job
+{
+public:
+    explicit CallJob(Fn &fn) : m_fn(fn) {}
+
+    virtual void Run() {m_result = m_fn();}
+
+    Fn &m_fn;
+    Result m_result;
+};
+
+// Make a libhdfs call, on a JNI worker if they are enabled.  `fn` must return
+// a value (all libhdfs functions do).
+template <typename Fn>
+auto CallHdfs(Fn fn) -> decltype(fn())
+{
+    if (!g_jni_workers) {return fn();}
+    CallJob<Fn, decltype(fn())> job(fn);
+    g_jni_workers->Execute(job);
+    return job.m_result;
+}
+
+}
+
+#endif